@@ -0,0 +1,86 @@
+-- Load the first file of the playlist repeatedly, and print percentiles of the
+-- time it takes from starting to load the file until the first frame is shown
+-- (or until audio playback starts for files without video), using the
+-- startup-phases property. Each phase is listed as well. Example:
+--
+--   mpv --script=TOOLS/lua/time-to-first-frame.lua \
+--       --script-opts=time-to-first-frame-runs=50 file.mkv
+--
+-- Use --vo=null and/or --ao=null to leave out the output drivers (but note
+-- that the VO is created only once anyway, and reused by later runs).
+
+local options = require 'mp.options'
+
+local o = {
+    runs = 20,
+}
+options.read_options(o)
+
+local path = nil
+local runs = 0
+local results = {}      -- phase name -> list of durations
+local phase_names = {}  -- phase names in order of first occurrence
+
+local function add_result(name, value)
+    if not results[name] then
+        results[name] = {}
+        phase_names[#phase_names + 1] = name
+    end
+    table.insert(results[name], value)
+end
+
+local function percentile(list, p)
+    local idx = math.max(1, math.ceil(#list * p / 100))
+    return list[idx]
+end
+
+local function report()
+    print(string.format("%d runs, milliseconds:", runs))
+    print(string.format("    %-20s %9s %9s %9s %9s %9s", "phase", "min", "p50",
+                        "p90", "p99", "max"))
+    for _, name in ipairs(phase_names) do
+        local list = results[name]
+        table.sort(list)
+        print(string.format("    %-20s %9.3f %9.3f %9.3f %9.3f %9.3f", name,
+                            list[1] * 1e3, percentile(list, 50) * 1e3,
+                            percentile(list, 90) * 1e3,
+                            percentile(list, 99) * 1e3, list[#list] * 1e3))
+    end
+end
+
+mp.observe_property("startup-phases", "native", function(_, phases)
+    if not phases or #phases == 0 or
+       phases[#phases].name ~= "playback-start"
+    then
+        return
+    end
+
+    -- Only the file loading part; the first run also contains program
+    -- startup phases.
+    local start = nil
+    local first_frame = nil
+    for _, phase in ipairs(phases) do
+        if phase.name == "start-file" then
+            start = phase.time
+        elseif start then
+            add_result(phase.name, phase.duration)
+            if phase.name == "first-frame" then
+                first_frame = phase.time
+            end
+        end
+    end
+    if not start then
+        return
+    end
+    local last = first_frame or phases[#phases].time
+    add_result("time-to-first-frame", last - start)
+
+    path = path or mp.get_property("path")
+    runs = runs + 1
+    if runs < o.runs then
+        mp.commandv("loadfile", path, "replace")
+    else
+        report()
+        mp.command("quit")
+    end
+end)
@@ -32,6 +32,9 @@ Currently, the following event types are supported:
     'event-timed' <ts> <name>   singular event at the given timestamp
     'value-timed' <ts> <float> <name>       a value for an event at the given timestamp
     'range-timed' <ts1> <ts2> <name>        like start/end, but explicit times
+    'flow-start' <id> <name>    flow between spans (ignored by this script)
+    'flow-step' <id> <name>     (see --dump-stats-format=trace)
+    'flow-end' <id> <name>
     <name>                      singular event (same as 'signal')
 
 """
@@ -114,6 +117,8 @@ for line in [line.split("#")[0].strip() for line in open(filename, "r")]:
         val = float(val)
         e = get_event(name, "value")
         e.vals.append((tsval, val))
+    elif event.startswith("flow-"):
+        continue
     elif event.startswith("signal "):
         name = event.split(" ", 2)[1]
         e = get_event(name, "event-signal")
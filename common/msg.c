@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -45,11 +46,27 @@
 
 #define TERM_BUF 100
 
+// Size of the stack buffer for formatting messages. Longer messages need an
+// allocation.
+#define MSG_BUF 1024
+
+// Number of messages that can be queued for the log thread.
+#define LOG_RING_SIZE 4096
+
+struct log_slot {
+    atomic_bool ready;
+    int terminal_level;                 // of the mp_log that sent it
+    int64_t time;                       // mp_time_us() when it was sent
+    uint64_t thread_id;                 // of the sender (only for stats)
+    struct mp_log_buffer_entry *entry;
+};
+
 struct mp_log_root {
     struct mpv_global *global;
     pthread_mutex_t lock;
-    pthread_mutex_t log_file_lock;
-    pthread_cond_t log_file_wakeup;
+    pthread_mutex_t log_thread_lock;
+    pthread_mutex_t wakeup_lock;
+    pthread_cond_t log_thread_wakeup;
     // --- protected by lock
     char **msg_levels;
     bool use_terminal;  // make accesses to stderr/stdout
@@ -61,25 +78,39 @@ struct mp_log_root {
     int verbose;
     bool really_quiet;
     bool force_stderr;
+    struct mp_log_buffer *early_buffer;
+    bstr buffer;
+    pthread_t log_thread;
+    // Ring buffer of messages for the log thread (see send_to_log_thread()).
+    // Set once when the log thread is started; NULL if it isn't running.
+    struct log_slot *ring;
+    // --- changed with both lock and log_thread_lock held, reading requires
+    //     either lock (the owner thread can read log_file without a lock)
     struct mp_log_buffer **buffers;
     int num_buffers;
-    struct mp_log_buffer *early_buffer;
+    FILE *log_file;
     FILE *stats_file;
-    bstr buffer;
+    bool stats_trace;   // write stats_file as trace events (not text)
+    // --- protected by log_thread_lock
+    int64_t num_trace_events;   // written to the current stats_file
     // --- must be accessed atomically
     /* This is incremented every time the msglevels must be reloaded.
      * (This is perhaps better than maintaining a globally accessible and
      * synchronized mp_log tree.) */
     atomic_ulong reload_counter;
+    atomic_int ring_used;           // number of claimed slots
+    mp_atomic_uint64 ring_write;    // position of the next slot to claim
+    atomic_int ring_dropped;        // messages not sent due to a full ring
+    atomic_bool log_thread_sleeping;
+    // --- log thread only (owner thread after the log thread was terminated)
+    uint64_t ring_read;             // position of the next slot to read
     // --- owner thread only (caller of mp_msg_init() etc.)
     char *log_path;
     char *stats_path;
-    pthread_t log_file_thread;
-    // --- owner thread only, but frozen while log_file_thread is running
-    FILE *log_file;
-    struct mp_log_buffer *log_file_buffer;
-    // --- protected by log_file_lock
-    bool log_file_thread_active; // also termination signal for the thread
+    // --- immutable
+    int pid;
+    // --- protected by wakeup_lock
+    bool log_thread_exit;
 };
 
 struct mp_log {
@@ -89,12 +120,17 @@ struct mp_log {
     int max_level;              // minimum log level for this instance
     int level;                  // minimum log level for any outputs
     int terminal_level;         // minimum log level for terminal output
+    int buffer_level;           // minimum log level for the log thread
+    bool send_stats;            // send MSGL_STATS to the log thread
     atomic_ulong reload_counter;
-    char *partial;
+    atomic_bool has_partial;    // partial[0] != '\0'
+    char *partial;              // protected by root->lock
 };
 
 struct mp_log_buffer {
     struct mp_log_root *root;
+    // Only the log thread writes to it. It's removed from root->buffers
+    // before destruction, so it doesn't need to be protected from writers.
     pthread_mutex_t lock;
     // --- protected by lock
     struct mp_log_buffer_entry **entries;   // ringbuffer
@@ -131,20 +167,29 @@ static void update_loglevel(struct mp_log *log)
             log->level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
     }
     log->terminal_level = log->level;
-    for (int n = 0; n < log->root->num_buffers; n++) {
-        int buffer_level = log->root->buffers[n]->level;
-        if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
-            buffer_level = MSGL_DEBUG;
-        if (buffer_level != MP_LOG_BUFFER_MSGL_TERM)
-            log->level = MPMAX(log->level, buffer_level);
-    }
-    if (log->root->log_file)
-        log->level = MPMAX(log->level, MSGL_DEBUG);
-    if (log->root->stats_file)
+    log->buffer_level = -1;
+    for (int n = 0; n < root->num_buffers; n++) {
+        int buffer_level = root->buffers[n]->level;
+        if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
+            buffer_level = log->terminal_level;
+        log->buffer_level = MPMAX(log->buffer_level, buffer_level);
+    }
+    if (root->log_file) {
+        log->buffer_level = MPMAX(log->buffer_level,
+                                  MPMAX(log->terminal_level, MSGL_DEBUG));
+    }
+    log->send_stats = !!root->stats_file;
+    if (!root->ring) {
+        log->buffer_level = -1;
+        log->send_stats = false;
+    }
+    log->level = MPMAX(log->level, log->buffer_level);
+    if (log->send_stats)
         log->level = MPMAX(log->level, MSGL_STATS);
     log->level = MPMIN(log->level, log->max_level);
+    log->buffer_level = MPMIN(log->buffer_level, log->max_level);
     if (root->really_quiet)
-        log->level = -1;
+        log->level = log->buffer_level = -1;
     atomic_store(&log->reload_counter, atomic_load(&log->root->reload_counter));
     pthread_mutex_unlock(&root->lock);
 }
@@ -336,50 +381,42 @@ static struct mp_log_buffer_entry *log_buffer_read(struct mp_log_buffer *buffer)
     return res;
 }
 
-static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
+// Allocate an entry with the strings in the same allocation.
+static struct mp_log_buffer_entry *new_entry(const char *prefix, int lev,
+                                             const char *text)
 {
-    struct mp_log_root *root = log->root;
+    size_t prefix_size = strlen(prefix) + 1;
+    size_t text_size = strlen(text) + 1;
+    struct mp_log_buffer_entry *entry =
+        talloc_size(NULL, sizeof(*entry) + prefix_size + text_size);
+    char *data = (char *)(entry + 1);
+    *entry = (struct mp_log_buffer_entry) {
+        .prefix = memcpy(data, prefix, prefix_size),
+        .level = lev,
+        .text = memcpy(data + prefix_size, text, text_size),
+    };
+    return entry;
+}
+
+// Log thread only, with log_thread_lock held.
+static void write_msg_to_buffers(struct mp_log_root *root, struct log_slot *slot)
+{
+    struct mp_log_buffer_entry *e = slot->entry;
     for (int n = 0; n < root->num_buffers; n++) {
         struct mp_log_buffer *buffer = root->buffers[n];
         bool wakeup = false;
         pthread_mutex_lock(&buffer->lock);
         int buffer_level = buffer->level;
         if (buffer_level == MP_LOG_BUFFER_MSGL_TERM)
-            buffer_level = log->terminal_level;
-        if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
-            buffer_level = MPMAX(log->terminal_level, MSGL_DEBUG);
-        if (lev <= buffer_level && lev != MSGL_STATUS) {
-            if (buffer->level == MP_LOG_BUFFER_MSGL_LOGFILE) {
-                // If the buffer is full, block until we can write again.
-                bool dead = false;
-                while (buffer->num_entries == buffer->capacity && !dead) {
-                    // Temporary unlock is OK; buffer->level is immutable, and
-                    // buffer can't go away because the global log lock is held.
-                    pthread_mutex_unlock(&buffer->lock);
-                    pthread_mutex_lock(&root->log_file_lock);
-                    if (root->log_file_thread_active) {
-                        pthread_cond_wait(&root->log_file_wakeup,
-                                          &root->log_file_lock);
-                    } else {
-                        dead = true;
-                    }
-                    pthread_mutex_unlock(&root->log_file_lock);
-                    pthread_mutex_lock(&buffer->lock);
-                }
-            }
+            buffer_level = slot->terminal_level;
+        if (e->level <= buffer_level) {
             if (buffer->num_entries == buffer->capacity) {
                 struct mp_log_buffer_entry *skip = log_buffer_read(buffer);
                 talloc_free(skip);
                 buffer->dropped += 1;
             }
-            struct mp_log_buffer_entry *entry = talloc_ptrtype(NULL, entry);
-            *entry = (struct mp_log_buffer_entry) {
-                .prefix = talloc_strdup(entry, log->verbose_prefix),
-                .level = lev,
-                .text = talloc_strdup(entry, text),
-            };
             int pos = (buffer->entry0 + buffer->num_entries) % buffer->capacity;
-            buffer->entries[pos] = entry;
+            buffer->entries[pos] = new_entry(e->prefix, e->level, e->text);
             buffer->num_entries += 1;
             if (buffer->wakeup_cb && !buffer->silent)
                 wakeup = true;
@@ -390,69 +427,308 @@ static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
     }
 }
 
-static void dump_stats(struct mp_log *log, int lev, char *text)
+// Log thread only, with log_thread_lock held.
+static void write_msg_to_log_file(struct mp_log_root *root,
+                                  struct log_slot *slot)
 {
-    struct mp_log_root *root = log->root;
-    if (lev == MSGL_STATS && root->stats_file)
-        fprintf(root->stats_file, "%"PRId64" %s\n", mp_time_us(), text);
+    struct mp_log_buffer_entry *e = slot->entry;
+    if (root->log_file && e->level <= MPMAX(slot->terminal_level, MSGL_DEBUG)) {
+        fprintf(root->log_file, "[%8.3f][%c][%s] %s",
+                (slot->time - MP_START_TIME) / 1e6,
+                mp_log_levels[e->level][0], e->prefix, e->text);
+    }
 }
 
-void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+// Log thread only, with log_thread_lock held.
+static void report_dropped(struct mp_log_root *root)
 {
-    if (!mp_msg_test(log, lev))
-        return; // do not display
+    int dropped = atomic_exchange(&root->ring_dropped, 0);
+    if (!dropped)
+        return;
+    if (root->log_file) {
+        fprintf(root->log_file, "[%8.3f][f][overflow] log thread overflow: "
+                "%d messages dropped\n",
+                (mp_time_us() - MP_START_TIME) / 1e6, dropped);
+    }
+    for (int n = 0; n < root->num_buffers; n++) {
+        struct mp_log_buffer *buffer = root->buffers[n];
+        pthread_mutex_lock(&buffer->lock);
+        buffer->dropped += dropped;
+        pthread_mutex_unlock(&buffer->lock);
+    }
+}
 
+static void write_json_string(FILE *f, bstr s)
+{
+    fputc('"', f);
+    for (int n = 0; n < s.len; n++) {
+        unsigned char c = s.start[n];
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+// Convert a MP_STATS line (see TOOLS/stats-conv.py for the syntax) to an event
+// in the Chrome trace event format. Spans are "start"/"end" pairs, which must
+// be properly nested per thread. Flows connect spans, possibly across threads:
+// "flow-start <id> <name>" and "flow-end <id> <name>" (and optionally
+// "flow-step") link the spans they are sent in if they use the same id and name.
+// Log thread only, with log_thread_lock held.
+static void write_trace_event(struct mp_log_root *root, struct log_slot *slot)
+{
+    FILE *f = root->stats_file;
+    bstr text = bstr0(slot->entry->text);
+    int64_t ts = slot->time, dur = 0;
+    double value = 0;
+    long long id = 0;
+    const char *ph = "i";
+
+    if (bstr_eatstart0(&text, "start ")) {
+        ph = "B";
+    } else if (bstr_eatstart0(&text, "end ")) {
+        ph = "E";
+    } else if (bstr_eatstart0(&text, "value ")) {
+        ph = "C";
+        value = bstrtod(text, &text);
+    } else if (bstr_eatstart0(&text, "event-timed ")) {
+        ts = bstrtoll(text, &text, 10);
+    } else if (bstr_eatstart0(&text, "value-timed ")) {
+        ph = "C";
+        ts = bstrtoll(text, &text, 10);
+        value = bstrtod(text, &text);
+    } else if (bstr_eatstart0(&text, "range-timed ")) {
+        ph = "X";
+        ts = bstrtoll(text, &text, 10);
+        dur = bstrtoll(text, &text, 10) - ts;
+    } else if (bstr_eatstart0(&text, "flow-start ")) {
+        ph = "s";
+        id = bstrtoll(text, &text, 10);
+    } else if (bstr_eatstart0(&text, "flow-step ")) {
+        ph = "t";
+        id = bstrtoll(text, &text, 10);
+    } else if (bstr_eatstart0(&text, "flow-end ")) {
+        ph = "f";
+        id = bstrtoll(text, &text, 10);
+    } else {
+        bstr_eatstart0(&text, "signal ");
+    }
+
+    if (root->num_trace_events++)
+        fprintf(f, ",\n");
+    fprintf(f, "{\"name\":");
+    write_json_string(f, bstr_strip(text));
+    fprintf(f, ",\"cat\":");
+    write_json_string(f, bstr0(slot->entry->prefix));
+    fprintf(f, ",\"ph\":\"%s\",\"ts\":%"PRId64",\"pid\":%d,\"tid\":%"PRIu64,
+            ph, ts - MP_START_TIME, root->pid, slot->thread_id);
+    switch (ph[0]) {
+    case 'i':
+        fprintf(f, ",\"s\":\"t\"");
+        break;
+    case 'C':
+        fprintf(f, ",\"args\":{\"value\":%f}", isfinite(value) ? value : 0);
+        break;
+    case 'X':
+        fprintf(f, ",\"dur\":%"PRId64, MPMAX(dur, 0));
+        break;
+    case 'f':
+        fprintf(f, ",\"bp\":\"e\"");
+        // fall through
+    case 's':
+    case 't':
+        fprintf(f, ",\"id\":%lld", id);
+        break;
+    }
+    fprintf(f, "}");
+}
+
+// Log thread only, with log_thread_lock held.
+static void write_msg_to_stats_file(struct mp_log_root *root,
+                                    struct log_slot *slot)
+{
+    if (!root->stats_file)
+        return;
+    if (root->stats_trace) {
+        write_trace_event(root, slot);
+    } else {
+        fprintf(root->stats_file, "%"PRId64" %s\n", slot->time,
+                slot->entry->text);
+    }
+}
+
+static void close_stats_file(FILE *f, bool trace)
+{
+    if (!f)
+        return;
+    if (trace)
+        fprintf(f, "\n]\n");
+    fclose(f);
+}
+
+static bool claim_slot(struct mp_log_root *root)
+{
+    int used = atomic_load(&root->ring_used);
+    while (used < LOG_RING_SIZE) {
+        if (atomic_compare_exchange_strong(&root->ring_used, &used, used + 1))
+            return true;
+    }
+    return false;
+}
+
+// Return the next readable slot, or NULL. Log thread only.
+static struct log_slot *peek_slot(struct mp_log_root *root)
+{
+    struct log_slot *slot = &root->ring[root->ring_read % LOG_RING_SIZE];
+    return atomic_load(&slot->ready) ? slot : NULL;
+}
+
+// Remove the slot returned by peek_slot(). Log thread only.
+static void pop_slot(struct mp_log_root *root)
+{
+    struct log_slot *slot = &root->ring[root->ring_read % LOG_RING_SIZE];
+    talloc_free(slot->entry);
+    slot->entry = NULL;
+    atomic_store(&slot->ready, false);
+    root->ring_read++;
+    atomic_fetch_add(&root->ring_used, -1);
+}
+
+// Pass a line to the log thread, which writes it to the log file and the log
+// buffers (or the stats file for MSGL_STATS). This takes no locks (except for
+// waking up an idle log thread), and never blocks: if the log thread falls
+// behind, the line is dropped, and the log thread reports the number of
+// dropped lines.
+static void send_to_log_thread(struct mp_log *log, int lev, char *text)
+{
     struct mp_log_root *root = log->root;
+    if (lev == MSGL_STATS ? !log->send_stats
+                          : lev > log->buffer_level || lev == MSGL_STATUS)
+        return;
 
-    pthread_mutex_lock(&root->lock);
+    if (!claim_slot(root)) {
+        atomic_fetch_add(&root->ring_dropped, 1);
+        return;
+    }
+    uint64_t pos = atomic_fetch_add(&root->ring_write, 1);
+    struct log_slot *slot = &root->ring[pos % LOG_RING_SIZE];
+    slot->terminal_level = log->terminal_level;
+    slot->time = mp_time_us();
+    slot->thread_id = lev == MSGL_STATS ? mpthread_get_id() : 0;
+    slot->entry = new_entry(log->verbose_prefix, lev, text);
+    atomic_store(&slot->ready, true);
+
+    if (atomic_load(&root->log_thread_sleeping)) {
+        pthread_mutex_lock(&root->wakeup_lock);
+        pthread_cond_signal(&root->log_thread_wakeup);
+        pthread_mutex_unlock(&root->wakeup_lock);
+    }
+}
 
-    root->buffer.len = 0;
+// Output each complete line in text, and return the start of the remaining
+// incomplete line. Terminal output requires holding root->lock.
+static char *write_lines(struct mp_log *log, int lev, char *text, bool terminal)
+{
+    while (1) {
+        char *end = strchr(text, '\n');
+        if (!end)
+            break;
+        char *next = &end[1];
+        char saved = next[0];
+        next[0] = '\0';
+        if (terminal)
+            print_terminal_line(log, lev, text, "");
+        send_to_log_thread(log, lev, text);
+        next[0] = saved;
+        text = next;
+    }
+    return text;
+}
 
-    if (log->partial[0])
-        bstr_xappend_asprintf(root, &root->buffer, "%s", log->partial);
-    log->partial[0] = '\0';
+// Output the message with root->lock held, for everything that needs it:
+// terminal output and partial lines.
+static void write_msg_locked(struct mp_log *log, int lev, char *text)
+{
+    struct mp_log_root *root = log->root;
 
-    bstr_xappend_vasprintf(root, &root->buffer, format, va);
+    pthread_mutex_lock(&root->lock);
 
-    char *text = root->buffer.start;
+    char *msg = text;
+    if (log->partial[0]) {
+        root->buffer.len = 0;
+        bstr_xappend_asprintf(root, &root->buffer, "%s%s", log->partial, text);
+        msg = root->buffer.start;
+    }
+    log->partial[0] = '\0';
 
-    if (lev == MSGL_STATS) {
-        dump_stats(log, lev, text);
-    } else if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
+    if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
         /* discard */
     } else {
         if (lev == MSGL_STATUS)
-            prepare_status_line(root, text);
+            prepare_status_line(root, msg);
 
         // Split away each line. Normally we require full lines; buffer partial
         // lines if they happen.
-        while (1) {
-            char *end = strchr(text, '\n');
-            if (!end)
-                break;
-            char *next = &end[1];
-            char saved = next[0];
-            next[0] = '\0';
-            print_terminal_line(log, lev, text, "");
-            write_msg_to_buffers(log, lev, text);
-            next[0] = saved;
-            text = next;
-        }
+        msg = write_lines(log, lev, msg, true);
 
         if (lev == MSGL_STATUS) {
-            if (text[0])
-                print_terminal_line(log, lev, text, "\r");
-        } else if (text[0]) {
-            int size = strlen(text) + 1;
+            if (msg[0])
+                print_terminal_line(log, lev, msg, "\r");
+        } else if (msg[0]) {
+            int size = strlen(msg) + 1;
             if (talloc_get_size(log->partial) < size)
                 log->partial = talloc_realloc(NULL, log->partial, char, size);
-            memcpy(log->partial, text, size);
+            memcpy(log->partial, msg, size);
         }
     }
 
+    atomic_store(&log->has_partial, !!log->partial[0]);
+
     pthread_mutex_unlock(&root->lock);
 }
 
+void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+{
+    if (!mp_msg_test(log, lev))
+        return; // do not display
+
+    // Format without holding any lock.
+    char buf[MSG_BUF];
+    char *text = buf;
+    va_list va_retry;
+    va_copy(va_retry, va);
+    int len = vsnprintf(buf, sizeof(buf), format, va);
+    if (len >= (int)sizeof(buf)) {
+        text = talloc_size(NULL, len + 1);
+        vsnprintf(text, len + 1, format, va_retry);
+    } else if (len < 0) {
+        len = 0;
+        buf[0] = '\0';
+    }
+    va_end(va_retry);
+
+    // Stats, and complete lines that don't go to the terminal (such as verbose
+    // messages for the log file) don't need the global lock.
+    if (lev == MSGL_STATS) {
+        send_to_log_thread(log, lev, text);
+    } else if (lev != MSGL_STATUS && len && text[len - 1] == '\n' &&
+               !atomic_load_explicit(&log->has_partial, memory_order_relaxed) &&
+               !test_terminal_level(log, lev))
+    {
+        write_lines(log, lev, text, false);
+    } else {
+        write_msg_locked(log, lev, text);
+    }
+
+    if (text != buf)
+        talloc_free(text);
+}
+
 static void destroy_log(void *ptr)
 {
     struct mp_log *log = ptr;
@@ -514,11 +790,13 @@ void mp_msg_init(struct mpv_global *global)
     *root = (struct mp_log_root){
         .global = global,
         .reload_counter = ATOMIC_VAR_INIT(1),
+        .pid = getpid(),
     };
 
     pthread_mutex_init(&root->lock, NULL);
-    pthread_mutex_init(&root->log_file_lock, NULL);
-    pthread_cond_init(&root->log_file_wakeup, NULL);
+    pthread_mutex_init(&root->log_thread_lock, NULL);
+    pthread_mutex_init(&root->wakeup_lock, NULL);
+    pthread_cond_init(&root->log_thread_wakeup, NULL);
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -526,68 +804,86 @@ void mp_msg_init(struct mpv_global *global)
     global->log = log;
 }
 
-static void *log_file_thread(void *p)
+// Write all queued messages.
+static void process_messages(struct mp_log_root *root)
 {
-    struct mp_log_root *root = p;
-
-    mpthread_set_name("log-file");
-
-    pthread_mutex_lock(&root->log_file_lock);
-
-    while (root->log_file_thread_active) {
-        struct mp_log_buffer_entry *e =
-            mp_msg_log_buffer_read(root->log_file_buffer);
-        if (e) {
-            pthread_mutex_unlock(&root->log_file_lock);
-            fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-                    (mp_time_us() - MP_START_TIME) / 1e6,
-                    mp_log_levels[e->level][0], e->prefix, e->text);
-            fflush(root->log_file);
-            pthread_mutex_lock(&root->log_file_lock);
-            talloc_free(e);
-            // Multiple threads might be blocked if the log buffer was full.
-            pthread_cond_broadcast(&root->log_file_wakeup);
+    pthread_mutex_lock(&root->log_thread_lock);
+    struct log_slot *slot;
+    while ((slot = peek_slot(root))) {
+        report_dropped(root);
+        if (slot->entry->level == MSGL_STATS) {
+            write_msg_to_stats_file(root, slot);
         } else {
-            pthread_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+            write_msg_to_log_file(root, slot);
+            write_msg_to_buffers(root, slot);
         }
+        pop_slot(root);
     }
+    report_dropped(root);
+    if (root->log_file)
+        fflush(root->log_file);
+    if (root->stats_file)
+        fflush(root->stats_file);
+    pthread_mutex_unlock(&root->log_thread_lock);
+}
+
+static void *log_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mpthread_set_name("log");
 
-    pthread_mutex_unlock(&root->log_file_lock);
+    pthread_mutex_lock(&root->wakeup_lock);
+    while (1) {
+        atomic_store(&root->log_thread_sleeping, false);
+        pthread_mutex_unlock(&root->wakeup_lock);
+
+        process_messages(root);
+
+        pthread_mutex_lock(&root->wakeup_lock);
+        if (root->log_thread_exit)
+            break;
+        // Senders check log_thread_sleeping after making a slot ready, so
+        // either they see it set and signal, or we see the new slot here.
+        atomic_store(&root->log_thread_sleeping, true);
+        if (!peek_slot(root))
+            pthread_cond_wait(&root->log_thread_wakeup, &root->wakeup_lock);
+    }
+    pthread_mutex_unlock(&root->wakeup_lock);
 
     return NULL;
 }
 
-static void wakeup_log_file(void *p)
+// Start the log thread if it isn't running yet. Must be called with root->lock
+// held. On failure, root->ring remains NULL, and nothing is sent to the log
+// file or log buffers.
+static void start_log_thread(struct mp_log_root *root)
 {
-    struct mp_log_root *root = p;
-
-    pthread_mutex_lock(&root->log_file_lock);
-    pthread_cond_broadcast(&root->log_file_wakeup);
-    pthread_mutex_unlock(&root->log_file_lock);
+    if (root->ring)
+        return;
+    root->ring = talloc_zero_array(root, struct log_slot, LOG_RING_SIZE);
+    if (pthread_create(&root->log_thread, NULL, log_thread, root)) {
+        TA_FREEP(&root->ring);
+        return;
+    }
+    atomic_fetch_add(&root->reload_counter, 1);
 }
 
 // Only to be called from the main thread.
-static void terminate_log_file_thread(struct mp_log_root *root)
+static void terminate_log_thread(struct mp_log_root *root)
 {
-    bool wait_terminate = false;
-
-    pthread_mutex_lock(&root->log_file_lock);
-    if (root->log_file_thread_active) {
-        root->log_file_thread_active = false;
-        pthread_cond_broadcast(&root->log_file_wakeup);
-        wait_terminate = true;
-    }
-    pthread_mutex_unlock(&root->log_file_lock);
+    if (!root->ring)
+        return;
 
-    if (wait_terminate)
-        pthread_join(root->log_file_thread, NULL);
+    pthread_mutex_lock(&root->wakeup_lock);
+    root->log_thread_exit = true;
+    pthread_cond_signal(&root->log_thread_wakeup);
+    pthread_mutex_unlock(&root->wakeup_lock);
 
-    mp_msg_log_buffer_destroy(root->log_file_buffer);
-    root->log_file_buffer = NULL;
+    pthread_join(root->log_thread, NULL);
 
-    if (root->log_file)
-        fclose(root->log_file);
-    root->log_file = NULL;
+    // Messages sent after the log thread's last round.
+    process_messages(root);
 }
 
 // If opt is different from *current_path, update *current_path and return true.
@@ -637,44 +933,58 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
     pthread_mutex_unlock(&root->lock);
 
     if (check_new_path(global, opts->log_file, &root->log_path)) {
-        terminate_log_file_thread(root);
+        FILE *new_file = NULL;
         if (root->log_path) {
-            root->log_file = fopen(root->log_path, "wb");
-            if (root->log_file) {
-                root->log_file_buffer =
-                    mp_msg_log_buffer_new(global, 100, MP_LOG_BUFFER_MSGL_LOGFILE,
-                                          wakeup_log_file, root);
-                root->log_file_thread_active = true;
-                if (pthread_create(&root->log_file_thread, NULL, log_file_thread,
-                                   root))
-                {
-                    root->log_file_thread_active = false;
-                    terminate_log_file_thread(root);
-                }
-            } else {
+            new_file = fopen(root->log_path, "wb");
+            if (!new_file) {
                 mp_err(global->log, "Failed to open log file '%s'\n",
                        root->log_path);
             }
         }
-    }
-
-    if (check_new_path(global, opts->dump_stats, &root->stats_path)) {
-        bool open_error = false;
 
         pthread_mutex_lock(&root->lock);
-        if (root->stats_file)
-            fclose(root->stats_file);
-        root->stats_file = NULL;
+        if (new_file)
+            start_log_thread(root);
+        pthread_mutex_lock(&root->log_thread_lock);
+        FILE *old_file = root->log_file;
+        root->log_file = new_file;
+        pthread_mutex_unlock(&root->log_thread_lock);
+        atomic_fetch_add(&root->reload_counter, 1);
+        pthread_mutex_unlock(&root->lock);
+
+        if (old_file)
+            fclose(old_file);
+    }
+
+    bool stats_trace = opts->dump_stats_format == 1;
+    if (check_new_path(global, opts->dump_stats, &root->stats_path) ||
+        stats_trace != root->stats_trace)
+    {
+        FILE *new_file = NULL;
         if (root->stats_path) {
-            root->stats_file = fopen(root->stats_path, "wb");
-            open_error = !root->stats_file;
+            new_file = fopen(root->stats_path, "wb");
+            if (!new_file) {
+                mp_err(global->log, "Failed to open stats file '%s'\n",
+                       root->stats_path);
+            } else if (stats_trace) {
+                fprintf(new_file, "[\n");
+            }
         }
+
+        pthread_mutex_lock(&root->lock);
+        if (new_file)
+            start_log_thread(root);
+        pthread_mutex_lock(&root->log_thread_lock);
+        FILE *old_file = root->stats_file;
+        bool old_trace = root->stats_trace;
+        root->stats_file = new_file;
+        root->stats_trace = stats_trace;
+        root->num_trace_events = 0;
+        pthread_mutex_unlock(&root->log_thread_lock);
+        atomic_fetch_add(&root->reload_counter, 1);
         pthread_mutex_unlock(&root->lock);
 
-        if (open_error) {
-            mp_err(global->log, "Failed to open stats file '%s'\n",
-                   root->stats_path);
-        }
+        close_stats_file(old_file, old_trace);
     }
 }
 
@@ -698,17 +1008,19 @@ bool mp_msg_has_log_file(struct mpv_global *global)
 void mp_msg_uninit(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
-    terminate_log_file_thread(root);
     mp_msg_log_buffer_destroy(root->early_buffer);
+    terminate_log_thread(root);
     assert(root->num_buffers == 0);
-    if (root->stats_file)
-        fclose(root->stats_file);
+    if (root->log_file)
+        fclose(root->log_file);
+    close_stats_file(root->stats_file, root->stats_trace);
     talloc_free(root->stats_path);
     talloc_free(root->log_path);
     m_option_type_msglevels.free(&root->msg_levels);
     pthread_mutex_destroy(&root->lock);
-    pthread_mutex_destroy(&root->log_file_lock);
-    pthread_cond_destroy(&root->log_file_wakeup);
+    pthread_mutex_destroy(&root->log_thread_lock);
+    pthread_mutex_destroy(&root->wakeup_lock);
+    pthread_cond_destroy(&root->log_thread_wakeup);
     talloc_free(root);
     global->log = NULL;
 }
@@ -758,8 +1070,10 @@ struct mp_log_buffer *mp_msg_log_buffer_new(struct mpv_global *global,
         if (root->early_buffer) {
             struct mp_log_buffer *buffer = root->early_buffer;
             root->early_buffer = NULL;
+            pthread_mutex_lock(&root->log_thread_lock);
             buffer->wakeup_cb = wakeup_cb;
             buffer->wakeup_cb_ctx = wakeup_cb_ctx;
+            pthread_mutex_unlock(&root->log_thread_lock);
             pthread_mutex_unlock(&root->lock);
             return buffer;
         }
@@ -779,7 +1093,11 @@ struct mp_log_buffer *mp_msg_log_buffer_new(struct mpv_global *global,
 
     pthread_mutex_init(&buffer->lock, NULL);
 
+    start_log_thread(root);
+
+    pthread_mutex_lock(&root->log_thread_lock);
     MP_TARRAY_APPEND(root, root->buffers, root->num_buffers, buffer);
+    pthread_mutex_unlock(&root->log_thread_lock);
 
     atomic_fetch_add(&root->reload_counter, 1);
     pthread_mutex_unlock(&root->lock);
@@ -802,6 +1120,7 @@ void mp_msg_log_buffer_destroy(struct mp_log_buffer *buffer)
     struct mp_log_root *root = buffer->root;
 
     pthread_mutex_lock(&root->lock);
+    pthread_mutex_lock(&root->log_thread_lock);
 
     for (int n = 0; n < root->num_buffers; n++) {
         if (root->buffers[n] == buffer) {
@@ -814,6 +1133,8 @@ void mp_msg_log_buffer_destroy(struct mp_log_buffer *buffer)
 
 found:
 
+    pthread_mutex_unlock(&root->log_thread_lock);
+
     while (buffer->num_entries)
         talloc_free(log_buffer_read(buffer));
 
@@ -832,7 +1153,7 @@ struct mp_log_buffer_entry *mp_msg_log_buffer_read(struct mp_log_buffer *buffer)
 
     pthread_mutex_lock(&buffer->lock);
 
-    if (!buffer->silent && buffer->num_entries) {
+    if (!buffer->silent && (buffer->num_entries || buffer->dropped)) {
         if (buffer->dropped) {
             res = talloc_ptrtype(NULL, res);
             *res = (struct mp_log_buffer_entry) {
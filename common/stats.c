@@ -27,6 +27,18 @@ struct stats_base {
     int num_entries;
 
     int64_t last_time;
+
+    // Phase profile, see stats_phase().
+    struct phase *phases;
+    int num_phases;
+    int64_t phases_start;
+    bool phases_ended;
+    bool phases_reset;
+};
+
+struct phase {
+    char name[32];
+    int64_t time;
 };
 
 struct stats_ctx {
@@ -100,6 +112,7 @@ void stats_global_init(struct mpv_global *global)
 
     global->stats = stats;
     stats->global = global;
+    stats->phases_start = MP_START_TIME;
 }
 
 static void add_stat(struct mpv_node *list, struct stat_entry *e,
@@ -210,6 +223,77 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
     pthread_mutex_unlock(&stats->lock);
 }
 
+static void add_phase(struct stats_base *stats, const char *name)
+{
+    struct phase ph = {.time = mp_time_us()};
+    snprintf(ph.name, sizeof(ph.name), "%s", name);
+    MP_TARRAY_APPEND(stats, stats->phases, stats->num_phases, ph);
+}
+
+void stats_phase(struct mpv_global *global, const char *name)
+{
+    struct stats_base *stats = global->stats;
+    MP_STATS(global, "signal phase-%s", name);
+    pthread_mutex_lock(&stats->lock);
+    if (!stats->phases_ended)
+        add_phase(stats, name);
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_phases_reset(struct mpv_global *global)
+{
+    struct stats_base *stats = global->stats;
+    pthread_mutex_lock(&stats->lock);
+    if (stats->phases_reset) {
+        stats->num_phases = 0;
+        stats->phases_start = mp_time_us();
+    }
+    stats->phases_reset = true;
+    stats->phases_ended = false;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_phases_end(struct mpv_global *global, const char *name,
+                      struct mp_log *log)
+{
+    struct stats_base *stats = global->stats;
+    MP_STATS(global, "signal phase-%s", name);
+    pthread_mutex_lock(&stats->lock);
+    if (!stats->phases_ended) {
+        add_phase(stats, name);
+        stats->phases_ended = true;
+        mp_verbose(log, "Time since %s (ms):\n",
+                   stats->phases_start == MP_START_TIME ? "program start"
+                                                        : "loading the file");
+        int64_t prev = stats->phases_start;
+        for (int n = 0; n < stats->num_phases; n++) {
+            struct phase *ph = &stats->phases[n];
+            mp_verbose(log, "    %-20s %9.3f (+%.3f)\n", ph->name,
+                       (ph->time - stats->phases_start) / 1e3,
+                       (ph->time - prev) / 1e3);
+            prev = ph->time;
+        }
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_global_query_phases(struct mpv_global *global, struct mpv_node *out)
+{
+    struct stats_base *stats = global->stats;
+    node_init(out, MPV_FORMAT_NODE_ARRAY, NULL);
+    pthread_mutex_lock(&stats->lock);
+    int64_t prev = stats->phases_start;
+    for (int n = 0; n < stats->num_phases; n++) {
+        struct phase *ph = &stats->phases[n];
+        struct mpv_node *ne = node_array_add(out, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", ph->name);
+        node_map_add_double(ne, "time", (ph->time - stats->phases_start) / 1e6);
+        node_map_add_double(ne, "duration", (ph->time - prev) / 1e6);
+        prev = ph->time;
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
 static void stats_ctx_destroy(void *p)
 {
     struct stats_ctx *ctx = p;
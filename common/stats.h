@@ -1,5 +1,6 @@
 #pragma once
 
+struct mp_log;
 struct mpv_global;
 struct mpv_node;
 struct stats_ctx;
@@ -7,6 +8,22 @@ struct stats_ctx;
 void stats_global_init(struct mpv_global *global);
 void stats_global_query(struct mpv_global *global, struct mpv_node *out);
 
+// Phase profile of program startup and file loading. Unlike the other stats,
+// this is always recorded. stats_phase() records the time at which the named
+// phase ended. Times are relative to program start, or to the last
+// stats_phases_reset() call (the first call keeps the program startup phases).
+void stats_phase(struct mpv_global *global, const char *name);
+void stats_phases_reset(struct mpv_global *global);
+
+// Record the last phase, and log a summary of the profile with MSGL_V. Ignore
+// stats_phase() calls until the next stats_phases_reset().
+void stats_phases_end(struct mpv_global *global, const char *name,
+                      struct mp_log *log);
+
+// Return the phase profile as array of maps with "name", "time" and
+// "duration" (time since the previous phase) entries, in seconds.
+void stats_global_query_phases(struct mpv_global *global, struct mpv_node *out);
+
 // stats_ctx can be free'd with ta_free(), or by using the ta_parent.
 struct stats_ctx *stats_ctx_create(void *ta_parent, struct mpv_global *global,
                                    const char *prefix);
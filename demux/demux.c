@@ -51,6 +51,7 @@
 #include "timeline.h"
 #include "stheader.h"
 #include "cue.h"
+#include "probe_cache.h"
 
 // Demuxer list
 extern const struct demuxer_desc demuxer_desc_edl;
@@ -3399,20 +3400,60 @@ static struct demuxer *demux_open(struct stream *stream,
         .filename = talloc_strdup(NULL, stream->url),
     };
 
+    // Reuse the result of a previous open of the same file, if it was done by
+    // a demuxer that behaves the same way at every check level.
+    char *cached_name = NULL, *cached_lavf = NULL;
+    if (!check_desc && demux_probe_cache_lookup(sinfo.filename, global, stream,
+                                                &cached_name, &cached_lavf))
+    {
+        for (int n = 0; demuxer_list[n]; n++) {
+            const struct demuxer_desc *desc = demuxer_list[n];
+            if (desc->ignores_check && strcmp(desc->name, cached_name) == 0) {
+                char *lavf_type = stream->lavf_type;
+                if (cached_lavf)
+                    stream->lavf_type = cached_lavf;
+                mp_verbose(log, "Using cached demuxer %s.\n", desc->name);
+                demuxer = open_given_type(global, log, desc, stream, &sinfo,
+                                          params, DEMUX_CHECK_REQUEST);
+                stream->lavf_type = lavf_type;
+                if (demuxer) {
+                    talloc_steal(demuxer, log);
+                    log = NULL;
+                    goto done;
+                }
+                mp_verbose(log, "Cached demuxer failed.\n");
+            }
+        }
+    }
+
+    // Demuxers which failed, and would fail the same way at later passes.
+    // Retrying them means probing the same data again (libavformat probes up
+    // to 10 MB of data with every format it supports), which can be the
+    // most expensive part of opening unknown or broken files.
+    bool failed[MP_ARRAY_SIZE(demuxer_list)] = {0};
+
     // Test demuxers from first to last, one pass for each check_levels[] entry
     for (int pass = 0; check_levels[pass] != -1; pass++) {
         enum demux_check level = check_levels[pass];
         mp_verbose(log, "Trying demuxers for level=%s.\n", d_level(level));
         for (int n = 0; demuxer_list[n]; n++) {
             const struct demuxer_desc *desc = demuxer_list[n];
-            if (!check_desc || desc == check_desc) {
+            if ((!check_desc || desc == check_desc) && !failed[n]) {
                 demuxer = open_given_type(global, log, desc, stream, &sinfo,
                                           params, level);
                 if (demuxer) {
                     talloc_steal(demuxer, log);
                     log = NULL;
+                    if (desc->ignores_check && !check_desc &&
+                        demuxer->desc == desc)
+                    {
+                        demux_probe_cache_store(global, stream, desc->name,
+                            desc == &demuxer_desc_lavf ? demuxer->filetype
+                                                       : NULL);
+                    }
                     goto done;
                 }
+                failed[n] = desc->ignores_check;
             }
         }
     }
@@ -3468,8 +3509,12 @@ struct demuxer *demux_open_url(const char *url,
         talloc_free(priv_cancel);
         return NULL;
     }
+    if (params->record_phases)
+        stats_phase(global, "stream-open");
     struct demuxer *d = demux_open(s, priv_cancel, params, global);
     if (d) {
+        if (params->record_phases)
+            stats_phase(global, "demux-probe");
         talloc_steal(d->in, priv_cancel);
         assert(d->cancel);
     } else {
@@ -103,6 +103,10 @@ typedef struct demuxer_desc {
     // If non-NULL, these are added to the global option list.
     const struct m_sub_options *options;
 
+    // If true, open() does not look at the check level, so it's not tried
+    // again with a lower level if it failed.
+    bool ignores_check;
+
     // Return 0 on success, otherwise -1
     int (*open)(struct demuxer *demuxer, enum demux_check check);
     // The following functions are all optional
@@ -179,6 +183,7 @@ struct demuxer_params {
     bool stream_record; // if true, enable stream recording if option is set
     int stream_flags;
     struct stream *external_stream; // if set, use this, don't open or close streams
+    bool record_phases; // if true, add opening steps to stats_phase()
     // result
     bool demuxer_failed;
 };
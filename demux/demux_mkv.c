@@ -3238,6 +3238,7 @@ static void mkv_free(struct demuxer *demuxer)
 const demuxer_desc_t demuxer_desc_matroska = {
     .name = "mkv",
     .desc = "Matroska",
+    .ignores_check = true,
     .open = demux_mkv_open,
     .read_packet = demux_mkv_read_packet,
     .close = mkv_free,
@@ -0,0 +1,127 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "misc/bstr.h"
+#include "misc/cache_file.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "options/path.h"
+#include "osdep/io.h"
+#include "stream/stream.h"
+#include "probe_cache.h"
+
+struct demux_probe_cache_opts {
+    char *cache_dir;
+};
+
+#define OPT_BASE_STRUCT struct demux_probe_cache_opts
+
+const struct m_sub_options demux_probe_cache_conf = {
+    .opts = (const struct m_option[]){
+        {"demuxer-probe-cache-dir", OPT_STRING(cache_dir), .flags = M_OPT_FILE},
+        {0}
+    },
+    .size = sizeof(struct demux_probe_cache_opts),
+};
+
+#define HEADER "mpv probe cache v1\n"
+
+// Return the cache file name for the stream, or NULL if the cache is disabled
+// or the stream can't be cached. *stamp is set to a string that identifies
+// the file contents.
+static char *get_cache_file(void *ta_ctx, struct mpv_global *global,
+                            struct stream *stream, char **stamp)
+{
+    if (!stream->is_local_file || !stream->path || stream->is_directory)
+        return NULL;
+
+    struct demux_probe_cache_opts *opts =
+        mp_get_config_group(ta_ctx, global, &demux_probe_cache_conf);
+    if (!opts->cache_dir || !opts->cache_dir[0])
+        return NULL;
+
+    char *path = stream->path;
+    if (!mp_path_is_absolute(bstr0(path))) {
+        char *cwd = mp_getcwd(ta_ctx);
+        if (!cwd)
+            return NULL;
+        path = mp_path_join(ta_ctx, cwd, path);
+    }
+
+    char *file_stamp = mp_cache_file_stamp(ta_ctx, path);
+    if (!file_stamp)
+        return NULL;
+    *stamp = talloc_asprintf(ta_ctx, "%s\n%s\n", path, file_stamp);
+
+    char *dir = mp_get_user_path(ta_ctx, global, opts->cache_dir);
+    return mp_cache_file_path(ta_ctx, dir, bstr0(path));
+}
+
+bool demux_probe_cache_lookup(void *ta_parent, struct mpv_global *global,
+                              struct stream *stream, char **demuxer,
+                              char **lavf_format)
+{
+    void *tmp = talloc_new(NULL);
+    bool ok = false;
+
+    char *stamp = NULL;
+    char *filename = get_cache_file(tmp, global, stream, &stamp);
+    if (!filename || stat(filename, &(struct stat){0}))
+        goto done;
+
+    bstr data = stream_read_file(filename, tmp, global, 4096);
+    if (!bstr_eatstart0(&data, HEADER) || !bstr_eatstart0(&data, stamp))
+        goto done;
+
+    bstr name = bstr_strip_linebreaks(bstr_getline(data, &data));
+    bstr format = bstr_strip_linebreaks(bstr_getline(data, &data));
+    if (!name.len)
+        goto done;
+
+    *demuxer = bstrto0(ta_parent, name);
+    *lavf_format = format.len ? bstrto0(ta_parent, format) : NULL;
+    ok = true;
+
+done:
+    talloc_free(tmp);
+    return ok;
+}
+
+void demux_probe_cache_store(struct mpv_global *global, struct stream *stream,
+                             const char *demuxer, const char *lavf_format)
+{
+    void *tmp = talloc_new(NULL);
+
+    char *stamp = NULL;
+    char *filename = get_cache_file(tmp, global, stream, &stamp);
+    if (!filename)
+        goto done;
+
+    char *data = talloc_asprintf(tmp, HEADER "%s%s\n%s\n", stamp, demuxer,
+                                 lavf_format ? lavf_format : "");
+
+    mp_cache_file_write(filename, bstr0(data));
+
+done:
+    talloc_free(tmp);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+
+struct mpv_global;
+struct stream;
+
+// If a cache entry exists for the stream, and the file didn't change since
+// then, return true and set *demuxer (and *lavf_format, if libavformat was
+// used) to the values which were stored with demux_probe_cache_store().
+// Allocations are done on ta_parent.
+bool demux_probe_cache_lookup(void *ta_parent, struct mpv_global *global,
+                              struct stream *stream, char **demuxer,
+                              char **lavf_format);
+
+// Remember the demuxer that opened the stream. lavf_format can be NULL.
+void demux_probe_cache_store(struct mpv_global *global, struct stream *stream,
+                             const char *demuxer, const char *lavf_format);
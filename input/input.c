@@ -40,6 +40,7 @@
 #include "osdep/timer.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/path.h"
@@ -69,10 +70,26 @@ struct cmd_bind {
     struct cmd_bind_section *owner;
 };
 
+// Lookup index for the binds of a section. Key sequences are inserted in
+// reverse order (last key first), so that the key history of a key event can
+// be matched by walking down from the root.
+struct bind_trie_node {
+    int key;
+    int binds[2];       // index of the user/builtin bind ending here, or -1
+    int *children;      // node indexes, sorted by key
+    int num_children;
+};
+
+struct bind_trie {
+    struct bind_trie_node *nodes; // nodes[0] is the root
+    int num_nodes;
+};
+
 struct cmd_bind_section {
     char *owner;
     struct cmd_bind *binds;
     int num_binds;
+    struct bind_trie *trie;     // NULL if binds changed since it was built
     char *section;
     struct mp_rect mouse_area;  // set at runtime, if at all
     bool mouse_area_set;        // mouse_area is valid and should be tested
@@ -85,6 +102,7 @@ struct cmd_bind_section {
 struct active_section {
     char *name;
     int flags;
+    struct cmd_bind_section *bs;
 };
 
 struct cmd_queue {
@@ -100,6 +118,7 @@ struct input_ctx {
     pthread_mutex_t mutex;
     struct mp_log *log;
     struct mpv_global *global;
+    struct stats_ctx *stats;
     struct m_config_cache *opts_cache;
     struct input_opts *opts;
 
@@ -372,42 +391,106 @@ static void key_buf_add(int *buf, int code)
     buf[0] = code;
 }
 
-static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
-                                                  char *section, int code)
+// Return the index of the child of the given node for key, or -1. If ins is
+// not NULL, *ins is set to the position where such a child would be inserted.
+static int trie_find_child(struct bind_trie *trie, int node, int key, int *ins)
 {
-    struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(section));
+    struct bind_trie_node *n = &trie->nodes[node];
+    int lo = 0, hi = n->num_children;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int child = n->children[mid];
+        if (trie->nodes[child].key == key)
+            return child;
+        if (trie->nodes[child].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (ins)
+        *ins = lo;
+    return -1;
+}
+
+static struct bind_trie *build_trie(struct cmd_bind_section *bs)
+{
+    struct bind_trie *trie = talloc_zero(bs, struct bind_trie);
+    struct bind_trie_node root = {.binds = {-1, -1}};
+    MP_TARRAY_APPEND(trie, trie->nodes, trie->num_nodes, root);
 
+    for (int n = 0; n < bs->num_binds; n++) {
+        struct cmd_bind *b = &bs->binds[n];
+        int node = 0;
+        for (int i = b->num_keys - 1; i >= 0; i--) {
+            int key = b->keys[i];
+            int ins = 0;
+            int child = trie_find_child(trie, node, key, &ins);
+            if (child < 0) {
+                struct bind_trie_node new = {.key = key, .binds = {-1, -1}};
+                child = trie->num_nodes;
+                MP_TARRAY_APPEND(trie, trie->nodes, trie->num_nodes, new);
+                struct bind_trie_node *parent = &trie->nodes[node];
+                MP_TARRAY_INSERT_AT(trie, parent->children,
+                                    parent->num_children, ins, child);
+            }
+            node = child;
+        }
+        // bind_keys() never adds the same key sequence twice per type.
+        trie->nodes[node].binds[b->is_builtin] = n;
+    }
+
+    return trie;
+}
+
+static void invalidate_trie(struct cmd_bind_section *bs)
+{
+    talloc_free(bs->trie);
+    bs->trie = NULL;
+}
+
+static struct cmd_bind *find_bind_in_section(struct input_ctx *ictx,
+                                             struct cmd_bind_section *bs,
+                                             int code)
+{
     if (!bs->num_binds)
         return NULL;
 
+    if (!bs->trie)
+        bs->trie = build_trie(bs);
+
+    // we have: keys=[key2 key1 keyX ...]
+    // and the trie contains: [key2 key1] (for a bind with keys=[key1 key2])
     int keys[MP_MAX_KEY_DOWN];
     memcpy(keys, ictx->key_history, sizeof(keys));
     key_buf_add(keys, code);
 
-    struct cmd_bind *best = NULL;
-
-    // Prefer user-defined keys over builtin bindings
-    for (int builtin = 0; builtin < 2; builtin++) {
-        if (builtin && !ictx->opts->default_bindings)
-            break;
-        if (best)
+    // Longest matching key sequence for user/builtin binds.
+    int best[2] = {-1, -1};
+    int node = 0;
+    for (int i = 0; i < MP_MAX_KEY_DOWN; i++) {
+        node = trie_find_child(bs->trie, node, keys[i], NULL);
+        if (node < 0)
             break;
-        for (int n = 0; n < bs->num_binds; n++) {
-            if (bs->binds[n].is_builtin == (bool)builtin) {
-                struct cmd_bind *b = &bs->binds[n];
-                // we have: keys=[key2 key1 keyX ...]
-                // and: b->keys=[key1 key2] (and may be just a prefix)
-                for (int i = 0; i < b->num_keys; i++) {
-                    if (b->keys[i] != keys[b->num_keys - 1 - i])
-                        goto skip;
-                }
-                if (!best || b->num_keys >= best->num_keys)
-                    best = b;
-            skip: ;
-            }
+        for (int builtin = 0; builtin < 2; builtin++) {
+            if (bs->trie->nodes[node].binds[builtin] >= 0)
+                best[builtin] = bs->trie->nodes[node].binds[builtin];
         }
     }
-    return best;
+
+    // Prefer user-defined keys over builtin bindings
+    if (best[0] >= 0)
+        return &bs->binds[best[0]];
+    if (best[1] >= 0 && ictx->opts->default_bindings)
+        return &bs->binds[best[1]];
+    return NULL;
+}
+
+static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
+                                                  char *section, int code)
+{
+    struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(section));
+    return find_bind_in_section(ictx, bs, code);
 }
 
 static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
@@ -430,7 +513,7 @@ static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
     struct cmd_bind *best_bind = NULL;
     for (int i = ictx->num_active_sections - 1; i >= 0; i--) {
         struct active_section *s = &ictx->active_sections[i];
-        struct cmd_bind *bind = find_bind_for_key_section(ictx, s->name, code);
+        struct cmd_bind *bind = find_bind_in_section(ictx, s->bs, code);
         if (bind) {
             struct cmd_bind_section *bs = bind->owner;
             if (!use_mouse || (bs->mouse_area_set && test_rect(&bs->mouse_area,
@@ -450,20 +533,26 @@ static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
     return best_bind;
 }
 
+static struct cmd_bind *find_bind_for_code(struct input_ctx *ictx,
+                                           char *force_section, int code)
+{
+    struct cmd_bind *bind = NULL;
+    if (MP_KEY_IS_UNICODE(code))
+        bind = find_any_bind_for_key(ictx, force_section, MP_KEY_ANY_UNICODE);
+    if (!bind)
+        bind = find_any_bind_for_key(ictx, force_section, code);
+    if (!bind)
+        bind = find_any_bind_for_key(ictx, force_section, MP_KEY_UNMAPPED);
+    return bind;
+}
+
 static mp_cmd_t *get_cmd_from_keys(struct input_ctx *ictx, char *force_section,
                                    int code)
 {
     if (ictx->opts->test)
         return handle_test(ictx, code);
 
-    struct cmd_bind *cmd = NULL;
-
-    if (MP_KEY_IS_UNICODE(code))
-        cmd = find_any_bind_for_key(ictx, force_section, MP_KEY_ANY_UNICODE);
-    if (!cmd)
-        cmd = find_any_bind_for_key(ictx, force_section, code);
-    if (!cmd)
-        cmd = find_any_bind_for_key(ictx, force_section, MP_KEY_UNMAPPED);
+    struct cmd_bind *cmd = find_bind_for_code(ictx, force_section, code);
     if (!cmd) {
         if (code == MP_KEY_CLOSE_WIN)
             return mp_input_parse_cmd_strv(ictx->log, (const char*[]){"quit", 0});
@@ -557,6 +646,14 @@ static struct mp_cmd *resolve_key(struct input_ctx *ictx, int code)
     return NULL;
 }
 
+// Whether both commands were created by the same key binding.
+static bool is_same_key_cmd(struct mp_cmd *a, struct mp_cmd *b)
+{
+    return a->key_name && b->key_name && strcmp(a->key_name, b->key_name) == 0 &&
+           a->input_section == b->input_section && !a->is_up_down &&
+           !b->is_up_down && strcmp(a->original, b->original) == 0;
+}
+
 static void interpret_key(struct input_ctx *ictx, int code, double scale,
                           int scale_units)
 {
@@ -623,6 +720,18 @@ static void interpret_key(struct input_ctx *ictx, int code, double scale,
     if (mp_input_is_scalable_cmd(cmd)) {
         cmd->scale = scale;
         cmd->scale_units = scale_units;
+        // Merge consecutive wheel events (touchpads and high resolution
+        // wheels send lots of them), so the player runs the command once.
+        struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
+        if (MP_KEY_IS_WHEEL(code & ~MP_KEY_MODIFIER_MASK) && tail &&
+            is_same_key_cmd(tail, cmd))
+        {
+            tail->scale += cmd->scale;
+            tail->scale_units += cmd->scale_units;
+            talloc_free(cmd);
+            stats_event(ictx->stats, "wheel-coalesced");
+            return;
+        }
         mp_input_queue_cmd(ictx, cmd);
     } else {
         // Non-scalable commands won't understand cmd->scale, so synthesize
@@ -844,6 +953,26 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y)
     ictx->mouse_vo_y = y;
 
     update_mouse_section(ictx);
+
+    // If the previous mouse move event wasn't read yet, and the new position
+    // resolves to the same binding, only update its position. This avoids
+    // parsing the command again for each event.
+    struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
+    if (tail && tail->mouse_move && !ictx->opts->test) {
+        struct cmd_bind *bind =
+            find_bind_for_code(ictx, NULL, MP_KEY_MOUSE_MOVE);
+        if (bind ? tail->input_section == bind->owner->section &&
+                   strcmp(tail->original, bind->cmd) == 0
+                 : !tail->input_section)
+        {
+            tail->mouse_x = x;
+            tail->mouse_y = y;
+            stats_event(ictx->stats, "mouse-move-coalesced");
+            input_unlock(ictx);
+            return;
+        }
+    }
+
     struct mp_cmd *cmd = get_cmd_from_keys(ictx, NULL, MP_KEY_MOUSE_MOVE);
     if (!cmd)
         cmd = mp_input_parse_cmd(ictx, bstr0("ignore"), "<internal>");
@@ -856,10 +985,10 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y)
             talloc_free(cmd);
         } else {
             // Coalesce with previous mouse move events (i.e. replace it)
-            struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
             if (tail && tail->mouse_move) {
                 queue_remove(&ictx->cmd_queue, tail);
                 talloc_free(tail);
+                stats_event(ictx->stats, "mouse-move-coalesced");
             }
             mp_input_queue_cmd(ictx, cmd);
         }
@@ -997,7 +1126,8 @@ void mp_input_disable_section(struct input_ctx *ictx, char *name)
 void mp_input_enable_section(struct input_ctx *ictx, char *name, int flags)
 {
     input_lock(ictx);
-    name = normalize_section(ictx, name);
+    struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(name));
+    name = bs->section;
 
     mp_input_disable_section(ictx, name);
 
@@ -1014,7 +1144,7 @@ void mp_input_enable_section(struct input_ctx *ictx, char *name, int flags)
             for (int n = ictx->num_active_sections; n > top; n--)
                 ictx->active_sections[n] = ictx->active_sections[n - 1];
         }
-        ictx->active_sections[top] = (struct active_section){name, flags};
+        ictx->active_sections[top] = (struct active_section){name, flags, bs};
         ictx->num_active_sections++;
     }
 
@@ -1052,7 +1182,7 @@ static bool test_mouse(struct input_ctx *ictx, int x, int y, int rej_flags)
         struct active_section *as = &ictx->active_sections[i];
         if (as->flags & rej_flags)
             continue;
-        struct cmd_bind_section *s = get_bind_section(ictx, bstr0(as->name));
+        struct cmd_bind_section *s = as->bs;
         if (s->mouse_area_set && test_rect(&s->mouse_area, x, y)) {
             res = true;
             break;
@@ -1092,6 +1222,7 @@ static void remove_binds(struct cmd_bind_section *bs, bool builtin)
             assert(bs->num_binds >= 1);
             bs->binds[n] = bs->binds[bs->num_binds - 1];
             bs->num_binds--;
+            invalidate_trie(bs);
         }
     }
 }
@@ -1167,6 +1298,7 @@ static void bind_keys(struct input_ctx *ictx, bool builtin, bstr section,
         struct cmd_bind empty = {{0}};
         MP_TARRAY_APPEND(bs, bs->binds, bs->num_binds, empty);
         bind = &bs->binds[bs->num_binds - 1];
+        invalidate_trie(bs);
     }
 
     bind_dealloc(bind);
@@ -1309,6 +1441,7 @@ struct input_ctx *mp_input_init(struct mpv_global *global,
         .global = global,
         .ar_state = -1,
         .log = mp_log_new(ictx, global->log, "input"),
+        .stats = stats_ctx_create(ictx, global, "input"),
         .mouse_section = "default",
         .opts_cache = m_config_cache_alloc(ictx, global, &input_config),
         .wakeup_cb = wakeup_cb,
@@ -1457,6 +1590,7 @@ void mp_input_bind_key(struct input_ctx *ictx, int key, bstr command)
         struct cmd_bind empty = {{0}};
         MP_TARRAY_APPEND(bs, bs->binds, bs->num_binds, empty);
         bind = &bs->binds[bs->num_binds - 1];
+        invalidate_trie(bs);
     }
 
     bind_dealloc(bind);
@@ -1490,7 +1624,7 @@ struct mpv_node mp_input_get_bindings(struct input_ctx *ictx)
 
         for (int i = 0; i < ictx->num_active_sections; i++) {
             struct active_section *as = &ictx->active_sections[i];
-            if (strcmp(as->name, s->section) == 0) {
+            if (as->bs == s) {
                 priority = i;
                 break;
             }
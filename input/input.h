@@ -227,13 +227,38 @@ bool mp_ipc_start_anon_client(struct mp_ipc_ctx *ctx, struct mpv_handle *h,
                               int out_fd[2]);
 void mp_uninit_ipc(struct mp_ipc_ctx *ctx);
 
+enum mp_ipc_protocol {
+    MP_IPC_PROTOCOL_JSON,       // newline terminated JSON
+    MP_IPC_PROTOCOL_MSGPACK,    // MessagePack prefixed with 32 bit BE size
+};
+
 // Serialize the given mpv_event structure to JSON. Returns an allocated string.
 struct mpv_event;
 char *mp_json_encode_event(struct mpv_event *event);
 
+// Like mp_json_encode_event(), but append the result (as a complete message in
+// the given protocol) to *dst.
+void mp_ipc_write_event(bstr *dst, struct mpv_event *event,
+                        enum mp_ipc_protocol protocol);
+
 // Given the raw IPC input buffer "buf", remove the first newline-separated
 // command, execute it and return the result (if any) as an allocated string.
 struct mpv_handle;
 char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
+// Execute a single command line (0-terminated, mutable, a newline at the end is
+// allowed), and append the result (if any) to *out. arena can be NULL.
+// *protocol is the current protocol of the connection, and can be changed by
+// the command. If protocol is NULL, the protocol can't be changed.
+struct json_arena;
+void mp_ipc_execute_line(struct mpv_handle *client,
+                         enum mp_ipc_protocol *protocol,
+                         struct json_arena *arena, char *line, bstr *out);
+
+// Like mp_ipc_execute_line(), but for a MessagePack message (without the size
+// prefix).
+void mp_ipc_execute_msgpack(struct mpv_handle *client,
+                            enum mp_ipc_protocol *protocol, bstr msg,
+                            bstr *out);
+
 #endif /* MPLAYER_INPUT_H */
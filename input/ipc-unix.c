@@ -26,8 +26,15 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 
+#include <libavutil/intreadwrite.h>
+
 #include "config.h"
 
+#if HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include "osdep/atomic.h"
 #include "osdep/io.h"
 #include "osdep/threads.h"
 
@@ -36,6 +43,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "libmpv/client.h"
+#include "misc/json.h"
 #include "options/m_config.h"
 #include "options/options.h"
 #include "options/path.h"
@@ -45,10 +53,22 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+// Output is written once this much has accumulated in the write buffer (and
+// at the end of each batch of events or input).
+#define WRITE_FLUSH_SIZE (64 * 1024)
+
+// The read buffer starts small, and grows while reads fill it completely.
+#define MIN_READ_SIZE 4096
+#define MAX_READ_SIZE (256 * 1024)
+
+// Maximum size of a single MessagePack message.
+#define MAX_MSGPACK_SIZE (64 * 1024 * 1024)
+
 struct mp_ipc_ctx {
     struct mp_log *log;
     struct mp_client_api *client_api;
     const char *path;
+    bool event_loop;
 
     pthread_t thread;
     int death_pipe[2];
@@ -64,13 +84,40 @@ struct client_arg {
     bool quit_on_close;
 
     bool writable;
+
+    // Input that was not executed yet (incomplete line).
+    bstr read_msg;
+    char *read_buf;
+    size_t read_size;
+
+    // Replies and events not yet written. Reused for the whole connection.
+    bstr wbuf;
+    // Reused for parsing every command.
+    struct json_arena *arena;
+    // Encoding of messages in both directions.
+    enum mp_ipc_protocol protocol;
+
+    // -- event loop mode only
+    bool in_event_loop;
+    bool closing;           // remove at the end of the loop iteration
+    unsigned ev_events;     // events currently registered with epoll
+    bstr out_buf;           // data that could not be written without blocking
+    atomic_bool wakeup;     // set by ev_client_wakeup_cb()
+    int *wakeup_pipe;       // event loop wakeup FDs
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static void ignore_sigpipe(void)
+{
+    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
+    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
+    sigfillset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
+}
+
+static int ipc_write_buf(struct client_arg *client, bstr data)
 {
-    size_t count = strlen(buf);
-    while (count > 0) {
-        ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
+    while (data.len > 0) {
+        ssize_t rc = send(client->client_fd, data.start, data.len, MSG_NOSIGNAL);
         if (rc <= 0) {
             if (rc == 0)
                 return -1;
@@ -80,35 +127,197 @@ static int ipc_write_str(struct client_arg *client, const char *buf)
                 return 0;
             }
 
+            // The event loop must not block on a single client. Keep the
+            // rest, and write it once the socket becomes writable.
+            if (errno == EAGAIN && client->in_event_loop) {
+                bstr_xappend(client, &client->out_buf, data);
+                return 0;
+            }
+
             if (errno == EINTR || errno == EAGAIN)
                 continue;
 
             return rc;
         }
 
-        count -= rc;
-        buf   += rc;
+        data = bstr_cut(data, rc);
     }
 
     return 0;
 }
 
+// Write everything in the write buffer.
+static int ipc_flush(struct client_arg *client)
+{
+    int rc = 0;
+    if (client->wbuf.len && client->writable) {
+        if (client->out_buf.len) {
+            // Still waiting for the socket; preserve the order.
+            bstr_xappend(client, &client->out_buf, client->wbuf);
+        } else {
+            rc = ipc_write_buf(client, client->wbuf);
+        }
+    }
+    client->wbuf.len = 0;
+    return rc;
+}
+
+// Call after appending a message to the write buffer.
+static int ipc_maybe_flush(struct client_arg *client)
+{
+    if (!client->writable)
+        client->wbuf.len = 0;
+    return client->wbuf.len >= WRITE_FLUSH_SIZE ? ipc_flush(client) : 0;
+}
+
+static void client_init(struct client_arg *arg)
+{
+    arg->read_msg = (bstr){ talloc_strdup(arg, ""), 0 };
+    arg->read_size = MIN_READ_SIZE;
+    arg->read_buf = talloc_size(arg, arg->read_size);
+    arg->wbuf = (bstr){ talloc_size(arg, WRITE_FLUSH_SIZE), 0 };
+    arg->arena = json_arena_create(arg);
+
+    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static void client_destroy(struct client_arg *arg)
+{
+    if (arg->read_msg.len > 0)
+        MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
+    if (arg->close_client_fd)
+        close(arg->client_fd);
+    struct mpv_handle *h = arg->client;
+    bool quit = arg->quit_on_close;
+    talloc_free(arg);
+    if (quit) {
+        mpv_terminate_destroy(h);
+    } else {
+        mpv_destroy(h);
+    }
+}
+
+// Encode all pending events, and write them in as few calls as possible.
+// Returns false if the client should be closed.
+static bool client_handle_events(struct client_arg *arg)
+{
+    while (1) {
+        mpv_event *event = mpv_wait_event(arg->client, 0);
+
+        if (event->event_id == MPV_EVENT_NONE)
+            break;
+
+        if (event->event_id == MPV_EVENT_SHUTDOWN)
+            return false;
+
+        if (!arg->writable)
+            continue;
+
+        mp_ipc_write_event(&arg->wbuf, event, arg->protocol);
+        if (ipc_maybe_flush(arg) < 0)
+            goto write_error;
+    }
+
+    if (ipc_flush(arg) < 0)
+        goto write_error;
+
+    return true;
+
+write_error:
+    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+    return false;
+}
+
+// Read and execute commands until the socket has no more data. If once is
+// set, stop after the first read() call. Returns false if the client should
+// be closed.
+static bool client_handle_input(struct client_arg *arg, bool once)
+{
+    while (1) {
+        ssize_t bytes = read(arg->client_fd, arg->read_buf, arg->read_size);
+        if (bytes < 0) {
+            if (errno == EAGAIN)
+                return true;
+
+            MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
+            return false;
+        }
+
+        if (bytes == 0) {
+            MP_VERBOSE(arg, "Client disconnected\n");
+            return false;
+        }
+
+        bstr_xappend(arg, &arg->read_msg, (bstr){arg->read_buf, bytes});
+
+        if (bytes == arg->read_size && arg->read_size < MAX_READ_SIZE) {
+            arg->read_size *= 2;
+            arg->read_buf = talloc_realloc_size(arg, arg->read_buf,
+                                                arg->read_size);
+        }
+
+        // Execute all complete messages, then drop them from the buffer at
+        // once. A message can switch the protocol for the following ones.
+        bstr rest = arg->read_msg;
+        while (1) {
+            if (arg->protocol == MP_IPC_PROTOCOL_MSGPACK) {
+                if (rest.len < 4)
+                    break;
+                uint32_t size = AV_RB32(rest.start);
+                if (size > MAX_MSGPACK_SIZE) {
+                    MP_ERR(arg, "Message too large\n");
+                    return false;
+                }
+                if (rest.len - 4 < size)
+                    break;
+                bstr msg = bstr_splice(rest, 4, 4 + size);
+                rest = bstr_cut(rest, 4 + size);
+
+                mp_ipc_execute_msgpack(arg->client, &arg->protocol, msg,
+                                       &arg->wbuf);
+            } else {
+                int nl = bstrchr(rest, '\n');
+                if (nl < 0)
+                    break;
+                char *line = rest.start;
+                line[nl] = '\0';
+                rest = bstr_cut(rest, nl + 1);
+
+                mp_ipc_execute_line(arg->client, &arg->protocol, arg->arena,
+                                    line, &arg->wbuf);
+            }
+            if (ipc_maybe_flush(arg) < 0)
+                goto write_error;
+        }
+        memmove(arg->read_msg.start, rest.start, rest.len);
+        arg->read_msg.len = rest.len;
+
+        if (ipc_flush(arg) < 0)
+            goto write_error;
+
+        if (once || arg->out_buf.len)
+            return true;
+    }
+
+write_error:
+    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+    return false;
+}
+
 static void *client_thread(void *p)
 {
     pthread_detach(pthread_self());
 
-    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
-    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
-    sigfillset(&sa.sa_mask);
-    sigaction(SIGPIPE, &sa, NULL);
+    ignore_sigpipe();
 
     int rc;
 
     struct client_arg *arg = p;
-    bstr client_msg = { talloc_strdup(NULL, ""), 0 };
 
     mpthread_set_name(arg->client_name);
 
+    client_init(arg);
+
     int pipe_fd = mpv_get_wakeup_pipe(arg->client);
     if (pipe_fd < 0) {
         MP_ERR(arg, "Could not get wakeup pipe\n");
@@ -122,8 +331,6 @@ static void *client_thread(void *p)
         {.events = POLLIN, .fd = arg->client_fd},
     };
 
-    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
-
     while (1) {
         rc = poll(fds, 2, 0);
         if (rc == 0)
@@ -136,92 +343,245 @@ static void *client_thread(void *p)
         if (fds[0].revents & POLLIN) {
             mp_flush_wakeup_pipe(pipe_fd);
 
-            while (1) {
-                mpv_event *event = mpv_wait_event(arg->client, 0);
+            if (!client_handle_events(arg))
+                break;
+        }
 
-                if (event->event_id == MPV_EVENT_NONE)
-                    break;
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
+            if (!client_handle_input(arg, false))
+                break;
+        }
+    }
 
-                if (event->event_id == MPV_EVENT_SHUTDOWN)
-                    goto done;
+done:
+    client_destroy(arg);
+    return NULL;
+}
 
-                if (!arg->writable)
-                    continue;
+#if HAVE_EPOLL
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
-                    MP_ERR(arg, "Encoding error\n");
-                    goto done;
-                }
+// Event loop shared by all IPC servers with --input-ipc-server-mode=event-loop.
+// It serves all their clients on a single thread. The thread is started with
+// the first client, and exits when the last client is gone.
+struct ipc_event_loop {
+    int epoll_fd;
+    int wakeup_pipe[2];
 
-                rc = ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
-                if (rc < 0) {
-                    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
-            }
-        }
+    // -- protected by ev_lock
+    struct client_arg **new_clients;
+    int num_new_clients;
 
-        if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
-            while (1) {
-                char buf[128];
-                bstr append = { buf, 0 };
+    // -- event loop thread only
+    struct client_arg **clients;
+    int num_clients;
+};
 
-                ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
-                if (bytes < 0) {
-                    if (errno == EAGAIN)
-                        break;
+static pthread_mutex_t ev_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ipc_event_loop *ev_loop; // currently running loop, or NULL
 
-                    MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+static void ev_client_wakeup_cb(void *d)
+{
+    struct client_arg *arg = d;
+    atomic_store(&arg->wakeup, true);
+    mp_signal_wakeup_fd(arg->wakeup_pipe);
+}
 
-                if (bytes == 0) {
-                    MP_VERBOSE(arg, "Client disconnected\n");
-                    goto done;
-                }
+// Wait for output to drain while data is pending, otherwise for input.
+static void ev_update_events(struct ipc_event_loop *loop, struct client_arg *arg)
+{
+    unsigned events = arg->out_buf.len ? EPOLLOUT : EPOLLIN;
+    if (events == arg->ev_events)
+        return;
+    struct epoll_event ev = {.events = events, .data.ptr = arg};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, arg->client_fd, &ev) < 0) {
+        arg->closing = true;
+        return;
+    }
+    arg->ev_events = events;
+}
 
-                append.len = bytes;
+static bool ev_write_pending(struct client_arg *arg)
+{
+    ssize_t rc = send(arg->client_fd, arg->out_buf.start, arg->out_buf.len,
+                      MSG_NOSIGNAL);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return true;
+        MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+        return false;
+    }
+    memmove(arg->out_buf.start, arg->out_buf.start + rc, arg->out_buf.len - rc);
+    arg->out_buf.len -= rc;
+    return true;
+}
 
-                bstr_xappend(NULL, &client_msg, append);
+static void ev_add_client(struct ipc_event_loop *loop, struct client_arg *arg)
+{
+    client_init(arg);
+    arg->in_event_loop = true;
+    arg->wakeup_pipe = loop->wakeup_pipe;
+    atomic_store(&arg->wakeup, true); // pick up initial events
+
+    arg->ev_events = EPOLLIN;
+    struct epoll_event ev = {.events = arg->ev_events, .data.ptr = arg};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, arg->client_fd, &ev) < 0) {
+        MP_ERR(arg, "Could not add client to event loop\n");
+        client_destroy(arg);
+        return;
+    }
 
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                        NULL, &client_msg);
+    mpv_set_wakeup_callback(arg->client, ev_client_wakeup_cb, arg);
+    MP_TARRAY_APPEND(loop, loop->clients, loop->num_clients, arg);
+    MP_VERBOSE(arg, "Client connected\n");
+}
 
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
-                        if (rc < 0) {
-                            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
-                            goto done;
-                        }
-                    }
+static void ev_remove_client(struct ipc_event_loop *loop, struct client_arg *arg)
+{
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, arg->client_fd, NULL);
+    // Guarantees that ev_client_wakeup_cb() is not running anymore.
+    mpv_set_wakeup_callback(arg->client, NULL, NULL);
+    client_destroy(arg);
+}
 
-                    talloc_free(reply_msg);
-                }
+static void *ev_loop_thread(void *p)
+{
+    pthread_detach(pthread_self());
+
+    ignore_sigpipe();
+
+    mpthread_set_name("ipc event loop");
+
+    struct ipc_event_loop *loop = p;
+
+    while (1) {
+        // Take over new clients; exit if there are no clients left.
+        pthread_mutex_lock(&ev_lock);
+        struct client_arg **new_clients = loop->new_clients;
+        int num_new_clients = loop->num_new_clients;
+        loop->new_clients = NULL;
+        loop->num_new_clients = 0;
+        if (!num_new_clients && !loop->num_clients) {
+            ev_loop = NULL;
+            pthread_mutex_unlock(&ev_lock);
+            break;
+        }
+        pthread_mutex_unlock(&ev_lock);
+
+        for (int n = 0; n < num_new_clients; n++)
+            ev_add_client(loop, new_clients[n]);
+        talloc_free(new_clients);
+        if (!loop->num_clients)
+            continue;
+
+        struct epoll_event events[16];
+        int num = epoll_wait(loop->epoll_fd, events, MP_ARRAY_SIZE(events), -1);
+
+        for (int n = 0; n < num; n++) {
+            struct client_arg *arg = events[n].data.ptr;
+            if (!arg) {
+                mp_flush_wakeup_pipe(loop->wakeup_pipe[0]);
+                continue;
+            }
+            if (arg->closing)
+                continue;
+            if (events[n].events & EPOLLOUT) {
+                arg->closing = !ev_write_pending(arg);
+            } else {
+                arg->closing = !client_handle_input(arg, true);
             }
         }
-    }
 
-done:
-    if (client_msg.len > 0)
-        MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
-    talloc_free(client_msg.start);
-    if (arg->close_client_fd)
-        close(arg->client_fd);
-    struct mpv_handle *h = arg->client;
-    bool quit = arg->quit_on_close;
-    talloc_free(arg);
-    if (quit) {
-        mpv_terminate_destroy(h);
-    } else {
-        mpv_destroy(h);
+        // Clients with pending output get their events once it is written,
+        // which leaves it to mpv's event queue to buffer them meanwhile.
+        for (int n = 0; n < loop->num_clients; n++) {
+            struct client_arg *arg = loop->clients[n];
+            if (!arg->closing && !arg->out_buf.len &&
+                atomic_exchange(&arg->wakeup, false))
+                arg->closing = !client_handle_events(arg);
+        }
+
+        for (int n = loop->num_clients - 1; n >= 0; n--) {
+            struct client_arg *arg = loop->clients[n];
+            if (!arg->closing)
+                ev_update_events(loop, arg);
+            if (arg->closing) {
+                ev_remove_client(loop, arg);
+                MP_TARRAY_REMOVE_AT(loop->clients, loop->num_clients, n);
+            }
+        }
     }
+
+    close(loop->epoll_fd);
+    mp_close_wakeup_fd(loop->wakeup_pipe);
+    talloc_free(loop);
     return NULL;
 }
 
+static struct ipc_event_loop *ev_loop_create(void)
+{
+    struct ipc_event_loop *loop = talloc_zero(NULL, struct ipc_event_loop);
+    loop->wakeup_pipe[0] = loop->wakeup_pipe[1] = -1;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0)
+        goto err;
+
+    if (mp_make_wakeup_fd(loop->wakeup_pipe) < 0)
+        goto err;
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_pipe[0], &ev) < 0)
+        goto err;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ev_loop_thread, loop))
+        goto err;
+
+    return loop;
+
+err:
+    if (loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    mp_close_wakeup_fd(loop->wakeup_pipe);
+    talloc_free(loop);
+    return NULL;
+}
+
+// Hand the client over to the event loop (starting it if needed).
+static bool ev_start_client(struct mp_ipc_ctx *ctx, struct client_arg *client)
+{
+    client->client = mp_new_client(ctx->client_api, client->client_name);
+    if (!client->client)
+        goto err;
+
+    client->log = mp_client_get_log(client->client);
+
+    pthread_mutex_lock(&ev_lock);
+    if (!ev_loop)
+        ev_loop = ev_loop_create();
+    if (!ev_loop) {
+        pthread_mutex_unlock(&ev_lock);
+        MP_ERR(ctx, "Could not start IPC event loop\n");
+        goto err;
+    }
+    MP_TARRAY_APPEND(ev_loop, ev_loop->new_clients, ev_loop->num_new_clients,
+                     client);
+    mp_signal_wakeup_fd(ev_loop->wakeup_pipe);
+    pthread_mutex_unlock(&ev_lock);
+
+    return true;
+
+err:
+    if (client->client)
+        mpv_destroy(client->client);
+    if (client->close_client_fd)
+        close(client->client_fd);
+    talloc_free(client);
+    return false;
+}
+
+#endif
+
 static bool ipc_start_client(struct mp_ipc_ctx *ctx, struct client_arg *client,
                              bool free_on_init_fail)
 {
@@ -263,6 +623,13 @@ static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
         .writable = true,
     };
 
+#if HAVE_EPOLL
+    if (ctx->event_loop && id >= 0) {
+        ev_start_client(ctx, client);
+        return;
+    }
+#endif
+
     ipc_start_client(ctx, client, true);
 }
 
@@ -392,9 +759,18 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
         .log        = mp_log_new(arg, global->log, "ipc"),
         .client_api = client_api,
         .path       = mp_get_user_path(arg, global, opts->ipc_path),
+        .event_loop = opts->ipc_server_mode == 1,
         .death_pipe = {-1, -1},
     };
 
+#if !HAVE_EPOLL
+    if (arg->event_loop) {
+        MP_WARN(arg, "--input-ipc-server-mode=event-loop is not supported on "
+                "this platform, using threads.\n");
+        arg->event_loop = false;
+    }
+#endif
+
     if (opts->ipc_client && opts->ipc_client[0]) {
         int fd = -1;
         if (strncmp(opts->ipc_client, "fd://", 5) == 0) {
@@ -415,7 +791,7 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
     if (!arg->path || !arg->path[0])
         goto out;
 
-    if (mp_make_wakeup_pipe(arg->death_pipe) < 0)
+    if (mp_make_wakeup_fd(arg->death_pipe) < 0)
         goto out;
 
     if (pthread_create(&arg->thread, NULL, ipc_thread, arg))
@@ -424,10 +800,7 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
     return arg;
 
 out:
-    if (arg->death_pipe[0] >= 0) {
-        close(arg->death_pipe[0]);
-        close(arg->death_pipe[1]);
-    }
+    mp_close_wakeup_fd(arg->death_pipe);
     talloc_free(arg);
     return NULL;
 }
@@ -437,10 +810,9 @@ void mp_uninit_ipc(struct mp_ipc_ctx *arg)
     if (!arg)
         return;
 
-    (void)write(arg->death_pipe[1], &(char){0}, 1);
+    mp_signal_wakeup_fd(arg->death_pipe);
     pthread_join(arg->thread, NULL);
 
-    close(arg->death_pipe[0]);
-    close(arg->death_pipe[1]);
+    mp_close_wakeup_fd(arg->death_pipe);
     talloc_free(arg);
 }
@@ -15,11 +15,16 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+
+#include <libavutil/intreadwrite.h>
+
 #include "config.h"
 
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "misc/node.h"
 #include "options/m_option.h"
 #include "options/options.h"
@@ -37,110 +42,198 @@ static mpv_node *mpv_node_array_get(mpv_node *src, int index)
     return &src->u.list->values[index];
 }
 
-static void mpv_node_map_add(void *ta_parent, mpv_node *src, const char *key, mpv_node *val)
-{
-    if (src->format != MPV_FORMAT_NODE_MAP)
-        return;
-
-    if (!src->u.list)
-        src->u.list = talloc_zero(ta_parent, mpv_node_list);
-
-    MP_TARRAY_GROW(src->u.list, src->u.list->keys, src->u.list->num);
-    MP_TARRAY_GROW(src->u.list, src->u.list->values, src->u.list->num);
-
-    src->u.list->keys[src->u.list->num] = talloc_strdup(ta_parent, key);
+// Stack allocated map with a fixed maximum number of entries. Used to build
+// replies and events without allocating.
+#define MAX_MAP_ENTRIES 5
 
-    static const struct m_option type = { .type = CONF_TYPE_NODE };
-    m_option_get_node(&type, ta_parent, &src->u.list->values[src->u.list->num], val);
+struct fixed_map {
+    char *keys[MAX_MAP_ENTRIES];
+    mpv_node values[MAX_MAP_ENTRIES];
+    mpv_node_list list;
+};
 
-    src->u.list->num++;
+static mpv_node fixed_map_init(struct fixed_map *map)
+{
+    map->list = (mpv_node_list){.keys = map->keys, .values = map->values};
+    return (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = &map->list};
 }
 
-static void mpv_node_map_add_null(void *ta_parent, mpv_node *src, const char *key)
+static void fixed_map_add(struct fixed_map *map, const char *key, mpv_node val)
 {
-    mpv_node val_node = {.format = MPV_FORMAT_NONE};
-    mpv_node_map_add(ta_parent, src, key, &val_node);
+    assert(map->list.num < MAX_MAP_ENTRIES);
+    map->keys[map->list.num] = (char *)key;
+    map->values[map->list.num] = val;
+    map->list.num++;
 }
 
-static void mpv_node_map_add_int64(void *ta_parent, mpv_node *src, const char *key, int64_t val)
+static void fixed_map_add_string(struct fixed_map *map, const char *key,
+                                 const char *val)
 {
-    mpv_node val_node = {.format = MPV_FORMAT_INT64, .u.int64 = val};
-    mpv_node_map_add(ta_parent, src, key, &val_node);
+    fixed_map_add(map, key, (mpv_node){.format = MPV_FORMAT_STRING,
+                                       .u.string = (char *)val});
 }
 
-static void mpv_node_map_add_string(void *ta_parent, mpv_node *src, const char *key, const char *val)
+static void fixed_map_add_int64(struct fixed_map *map, const char *key,
+                                int64_t val)
 {
-    mpv_node val_node = {.format = MPV_FORMAT_STRING, .u.string = (char*)val};
-    mpv_node_map_add(ta_parent, src, key, &val_node);
+    fixed_map_add(map, key, (mpv_node){.format = MPV_FORMAT_INT64,
+                                       .u.int64 = val});
 }
 
-// This is supposed to write a reply that looks like "normal" command execution.
-static void mpv_format_command_reply(void *ta_parent, mpv_event *event,
-                                     mpv_node *dst)
+// Append a single message in the given protocol: JSON followed by a newline,
+// or MessagePack preceded by its size as 32 bit big endian integer.
+static void write_message(bstr *dst, mpv_node *node,
+                          enum mp_ipc_protocol protocol)
 {
-    assert(event->event_id == MPV_EVENT_COMMAND_REPLY);
-    mpv_event_command *cmd = event->data;
-
-    mpv_node_map_add_int64(ta_parent, dst, "request_id", event->reply_userdata);
-
-    mpv_node_map_add_string(ta_parent, dst, "error",
-                            mpv_error_string(event->error));
-
-    mpv_node_map_add(ta_parent, dst, "data", &cmd->result);
+    switch (protocol) {
+    case MP_IPC_PROTOCOL_JSON:
+        json_write_bstr(dst, node);
+        bstr_xappend(NULL, dst, bstr0("\n"));
+        break;
+    case MP_IPC_PROTOCOL_MSGPACK: {
+        size_t start = dst->len;
+        bstr_xappend(NULL, dst, (bstr){"\0\0\0\0", 4});
+        if (msgpack_write(dst, node) < 0) {
+            dst->len = start;
+            break;
+        }
+        AV_WB32(dst->start + start, dst->len - start - 4);
+        break;
+    }
+    }
 }
 
-char *mp_json_encode_event(mpv_event *event)
+// Append the event as a single message to *dst. dst->start must be a talloc
+// allocation or NULL. The common high-frequency events are written without
+// creating a temporary node tree.
+void mp_ipc_write_event(bstr *dst, mpv_event *event,
+                        enum mp_ipc_protocol protocol)
 {
-    void *ta_parent = talloc_new(NULL);
-
-    struct mpv_node event_node;
-    if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
-        event_node = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
-        mpv_format_command_reply(ta_parent, event, &event_node);
-    } else {
-        mpv_event_to_node(&event_node, event);
+    struct fixed_map map;
+    mpv_node node = fixed_map_init(&map);
+
+    switch (event->event_id) {
+    case MPV_EVENT_COMMAND_REPLY: {
+        // This is supposed to look like "normal" command execution.
+        mpv_event_command *cmd = event->data;
+        fixed_map_add_int64(&map, "request_id", event->reply_userdata);
+        fixed_map_add_string(&map, "error", mpv_error_string(event->error));
+        fixed_map_add(&map, "data", cmd->result);
+        write_message(dst, &node, protocol);
+        break;
+    }
+    case MPV_EVENT_PROPERTY_CHANGE: {
+        // Must produce the same output as mpv_event_to_node().
+        mpv_event_property *prop = event->data;
+        fixed_map_add_string(&map, "event", mpv_event_name(event->event_id));
+        if (event->error < 0)
+            fixed_map_add_string(&map, "error", mpv_error_string(event->error));
+        if (event->reply_userdata)
+            fixed_map_add_int64(&map, "id", event->reply_userdata);
+        fixed_map_add_string(&map, "name", prop->name);
+        switch (prop->format) {
+        case MPV_FORMAT_NODE:
+            fixed_map_add(&map, "data", *(mpv_node *)prop->data);
+            break;
+        case MPV_FORMAT_DOUBLE:
+            fixed_map_add(&map, "data", (mpv_node){.format = MPV_FORMAT_DOUBLE,
+                                    .u.double_ = *(double *)prop->data});
+            break;
+        case MPV_FORMAT_FLAG:
+            fixed_map_add(&map, "data", (mpv_node){.format = MPV_FORMAT_FLAG,
+                                    .u.flag = *(int *)prop->data});
+            break;
+        case MPV_FORMAT_STRING:
+            fixed_map_add_string(&map, "data", *(char **)prop->data);
+            break;
+        default: ;
+        }
+        write_message(dst, &node, protocol);
+        break;
+    }
+    default:
+        mpv_event_to_node(&node, event);
+        write_message(dst, &node, protocol);
         // Abuse mpv_event_to_node() internals.
-        talloc_steal(ta_parent, node_get_alloc(&event_node));
+        talloc_free(node_get_alloc(&node));
     }
+}
 
-    char *output = talloc_strdup(NULL, "");
-    json_write(&output, &event_node);
-    output = ta_talloc_strdup_append(output, "\n");
+char *mp_json_encode_event(mpv_event *event)
+{
+    bstr output = {0};
+    mp_ipc_write_event(&output, event, MP_IPC_PROTOCOL_JSON);
+    return output.start;
+}
 
-    talloc_free(ta_parent);
+// Read the optional rate limit arguments of the observe commands, starting at
+// args[first].
+static bool get_observe_limits(mpv_node_list *args, int first,
+                               double *min_interval, double *min_delta)
+{
+    double *out[2] = {min_interval, min_delta};
+    for (int n = 0; n < 2; n++) {
+        *out[n] = 0;
+        if (first + n >= args->num)
+            continue;
+        mpv_node *v = &args->values[first + n];
+        if (v->format == MPV_FORMAT_INT64) {
+            *out[n] = v->u.int64;
+        } else if (v->format == MPV_FORMAT_DOUBLE) {
+            *out[n] = v->u.double_;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
 
-    return output;
+static bool get_protocol(const char *name, enum mp_ipc_protocol *out)
+{
+    if (!strcmp(name, "json")) {
+        *out = MP_IPC_PROTOCOL_JSON;
+    } else if (!strcmp(name, "msgpack")) {
+        *out = MP_IPC_PROTOCOL_MSGPACK;
+    } else {
+        return false;
+    }
+    return true;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+// Execute a single request, and append the reply (if any) to *out. If
+// msg_node is NULL, only an error reply is generated. *protocol selects the
+// encoding of the reply, and is changed by the "set_ipc_protocol" command.
+// If protocol is NULL, JSON is used, and switching is not possible. Switching
+// is not possible within batches either (in_batch), because the replies of a
+// batch must all use the same encoding.
+static void json_execute_node(struct mpv_handle *client,
+                              enum mp_ipc_protocol *protocol, bool in_batch,
+                              mpv_node *msg_node, bstr *out)
 {
     int rc;
     const char *cmd = NULL;
     struct mp_log *log = mp_client_get_log(client);
 
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+    struct fixed_map reply;
+    mpv_node reply_node = fixed_map_init(&reply);
     mpv_node *reqid_node = NULL;
     int64_t reqid = 0;
     mpv_node *async_node = NULL;
     bool async = false;
     bool send_reply = true;
-
-    rc = json_parse(ta_parent, &msg_node, &src, 50);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
+    // Owned by this function, freed after the reply was written.
+    mpv_node result_node = {0};
+    char *result_str = NULL;
+    // The reply to "set_ipc_protocol" still uses the old protocol.
+    enum mp_ipc_protocol reply_protocol =
+        protocol ? *protocol : MP_IPC_PROTOCOL_JSON;
+
+    if (!msg_node || msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
-    }
-
-    async_node = node_map_get(&msg_node, "async");
+    async_node = node_map_get(msg_node, "async");
     if (async_node) {
         if (async_node->format != MPV_FORMAT_FLAG) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -149,7 +242,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         async = async_node->u.flag;
     }
 
-    reqid_node = node_map_get(&msg_node, "request_id");
+    reqid_node = node_map_get(msg_node, "request_id");
     if (reqid_node) {
         if (reqid_node->format == MPV_FORMAT_INT64) {
             reqid = reqid_node->u.int64;
@@ -163,7 +256,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         }
     }
 
-    mpv_node *cmd_node = node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = node_map_get(msg_node, "command");
     if (!cmd_node) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
@@ -181,19 +274,17 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
     if (cmd && !strcmp("client_name", cmd)) {
         const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
+        fixed_map_add_string(&reply, "data", client_name);
         rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_time_us", cmd)) {
         int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
+        fixed_map_add_int64(&reply, "data", time_us);
         rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_version", cmd)) {
         int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
+        fixed_map_add_int64(&reply, "data", ver);
         rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_property", cmd)) {
-        mpv_node result_node;
-
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
@@ -206,10 +297,8 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &result_node);
-        if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
-            mpv_free_node_contents(&result_node);
-        }
+        if (rc >= 0)
+            fixed_map_add(&reply, "data", result_node);
     } else if (cmd && !strcmp("get_property_string", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -221,13 +310,12 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             goto error;
         }
 
-        char *result = mpv_get_property_string(client,
+        result_str = mpv_get_property_string(client,
                                         cmd_node->u.list->values[1].u.string);
-        if (result) {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
-            mpv_free(result);
+        if (result_str) {
+            fixed_map_add_string(&reply, "data", result_str);
         } else {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
+            fixed_map_add(&reply, "data", (mpv_node){.format = MPV_FORMAT_NONE});
         }
     } else if (cmd && (!strcmp("set_property", cmd) ||
                        !strcmp("set_property_string", cmd)))
@@ -244,8 +332,32 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_set_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &cmd_node->u.list->values[2]);
+    } else if (cmd && !strcmp("set_ipc_protocol", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        enum mp_ipc_protocol new_protocol;
+        if (!get_protocol(cmd_node->u.list->values[1].u.string, &new_protocol)) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (!protocol || in_batch) {
+            rc = MPV_ERROR_NOT_IMPLEMENTED;
+            goto error;
+        }
+
+        *protocol = new_protocol;
+        rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("observe_property", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        if (cmd_node->u.list->num < 3 || cmd_node->u.list->num > 5) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
@@ -260,12 +372,18 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_NODE);
+        double min_interval, min_delta;
+        if (!get_observe_limits(cmd_node->u.list, 3, &min_interval, &min_delta)) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        rc = mpv_observe_property_limited(client,
+                                          cmd_node->u.list->values[1].u.int64,
+                                          cmd_node->u.list->values[2].u.string,
+                                          MPV_FORMAT_NODE, min_interval, min_delta);
     } else if (cmd && !strcmp("observe_property_string", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        if (cmd_node->u.list->num < 3 || cmd_node->u.list->num > 5) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
@@ -280,10 +398,16 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_STRING);
+        double min_interval, min_delta;
+        if (!get_observe_limits(cmd_node->u.list, 3, &min_interval, &min_delta)) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        rc = mpv_observe_property_limited(client,
+                                          cmd_node->u.list->values[1].u.int64,
+                                          cmd_node->u.list->values[2].u.string,
+                                          MPV_FORMAT_STRING, min_interval, min_delta);
     } else if (cmd && !strcmp("unobserve_property", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -344,8 +468,6 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             rc = mpv_request_event(client, event, enable);
         }
     } else {
-        mpv_node result_node = {0};
-
         if (async) {
             rc = mpv_command_node_async(client, reqid, cmd_node);
             if (rc >= 0)
@@ -353,10 +475,8 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         } else {
             rc = mpv_command_node(client, cmd_node, &result_node);
             if (rc >= 0)
-                mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+                fixed_map_add(&reply, "data", result_node);
         }
-
-        mpv_free_node_contents(&result_node);
     }
 
 error:
@@ -365,52 +485,139 @@ error:
      * the original requests.
      */
     if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        fixed_map_add(&reply, "request_id", *reqid_node);
     } else {
-        mpv_node_map_add_int64(ta_parent, &reply_node, "request_id", 0);
+        fixed_map_add_int64(&reply, "request_id", 0);
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    fixed_map_add_string(&reply, "error", mpv_error_string(rc));
 
-    char *output = talloc_strdup(ta_parent, "");
+    if (send_reply)
+        write_message(out, &reply_node, reply_protocol);
 
-    if (send_reply) {
-        json_write(&output, &reply_node);
-        output = ta_talloc_strdup_append(output, "\n");
-    }
+    mpv_free_node_contents(&result_node);
+    mpv_free(result_str);
+}
 
-    return output;
+// Parse a request. Uses the arena if it's set, tmp otherwise.
+static int parse_request(struct json_arena *arena, void *tmp, mpv_node *dst,
+                         char *src)
+{
+    if (arena)
+        return json_parse_arena(arena, dst, &src, 50);
+    return json_parse(tmp, dst, &src, 50);
 }
 
-static char *text_execute_command(struct mpv_handle *client, void *tmp, char *src)
+// Execute an array of requests while keeping the core locked, and append all
+// replies in order.
+static void execute_batch(struct mpv_handle *client,
+                          enum mp_ipc_protocol *protocol, mpv_node *msg_node,
+                          bstr *out)
 {
-    mpv_command_string(client, src);
+    mp_client_begin_batch(client);
+    for (int n = 0; n < msg_node->u.list->num; n++)
+        json_execute_node(client, protocol, true, &msg_node->u.list->values[n],
+                          out);
+    mp_client_end_batch(client);
+}
 
-    return NULL;
+// Function is allowed to modify src[n].
+static void json_execute_command(struct mpv_handle *client,
+                                 enum mp_ipc_protocol *protocol,
+                                 struct json_arena *arena, void *tmp,
+                                 char *src, bstr *out)
+{
+    mpv_node msg_node;
+    if (parse_request(arena, tmp, &msg_node, src) < 0) {
+        mp_err(mp_client_get_log(client), "malformed JSON received: '%s'\n", src);
+        json_execute_node(client, protocol, false, NULL, out);
+        return;
+    }
+    json_execute_node(client, protocol, false, &msg_node, out);
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+// Function is allowed to modify src[n].
+static void json_execute_batch(struct mpv_handle *client,
+                               enum mp_ipc_protocol *protocol,
+                               struct json_arena *arena, void *tmp,
+                               char *src, bstr *out)
 {
-    void *tmp = talloc_new(NULL);
+    mpv_node msg_node;
+    if (parse_request(arena, tmp, &msg_node, src) < 0 ||
+        msg_node.format != MPV_FORMAT_NODE_ARRAY)
+    {
+        mp_err(mp_client_get_log(client), "malformed JSON batch received\n");
+        json_execute_node(client, protocol, false, NULL, out);
+        return;
+    }
+    execute_batch(client, protocol, &msg_node, out);
+}
 
-    bstr rest;
-    bstr line = bstr_getline(*buf, &rest);
-    char *line0 = bstrto0(tmp, line);
-    talloc_steal(tmp, buf->start);
-    *buf = bstrdup(NULL, rest);
+/* Execute a single input line, and append the reply (if any) to *out.
+ * line must be 0-terminated, and is mutated. If arena is set, it's used for
+ * parsing and is reset before returning, otherwise temporary memory is
+ * allocated for each call. protocol is the connection's current protocol
+ * (see json_execute_node()).
+ */
+void mp_ipc_execute_line(struct mpv_handle *client,
+                         enum mp_ipc_protocol *protocol,
+                         struct json_arena *arena, char *line, bstr *out)
+{
+    void *tmp = arena ? NULL : talloc_new(NULL);
 
-    json_skip_whitespace(&line0);
+    json_skip_whitespace(&line);
 
-    char *reply_msg = NULL;
-    if (line0[0] == '\0' || line0[0] == '#') {
+    if (line[0] == '\0' || line[0] == '#') {
         // skip
-    } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+    } else if (line[0] == '{') {
+        json_execute_command(client, protocol, arena, tmp, line, out);
+    } else if (line[0] == '[') {
+        json_execute_batch(client, protocol, arena, tmp, line, out);
+    } else {
+        mpv_command_string(client, line);
+    }
+
+    if (arena)
+        json_arena_reset(arena);
+    talloc_free(tmp);
+}
+
+// Execute a single MessagePack message (without the size prefix), and append
+// the reply (if any) to *out. Like with JSON, the message is either a request
+// map or an array of requests, which is executed as batch.
+void mp_ipc_execute_msgpack(struct mpv_handle *client,
+                            enum mp_ipc_protocol *protocol, bstr msg,
+                            bstr *out)
+{
+    void *tmp = talloc_new(NULL);
+
+    mpv_node msg_node;
+    if (msgpack_parse(tmp, &msg_node, &msg, 50) < 0 || msg.len) {
+        mp_err(mp_client_get_log(client), "malformed MessagePack received\n");
+        json_execute_node(client, protocol, false, NULL, out);
+    } else if (msg_node.format == MPV_FORMAT_NODE_ARRAY) {
+        execute_batch(client, protocol, &msg_node, out);
     } else {
-        reply_msg = text_execute_command(client, tmp, line0);
+        json_execute_node(client, protocol, false, &msg_node, out);
     }
 
-    talloc_steal(ctx, reply_msg);
     talloc_free(tmp);
-    return reply_msg;
+}
+
+char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+{
+    bstr rest;
+    bstr line = bstr_getline(*buf, &rest);
+    char *line0 = bstrto0(NULL, line);
+    bstr reply = {0};
+    mp_ipc_execute_line(client, NULL, NULL, line0, &reply);
+    talloc_free(line0);
+    char *old = buf->start;
+    *buf = bstrdup(NULL, rest);
+    talloc_free(old);
+    if (!reply.len) {
+        talloc_free(reply.start);
+        return NULL;
+    }
+    return talloc_steal(ctx, reply.start);
 }
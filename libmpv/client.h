@@ -235,7 +235,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 109)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 110)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -1273,6 +1273,38 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
 int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
                          const char *name, mpv_format format);
 
+/**
+ * Like mpv_observe_property(), but limit how often change events are sent.
+ * This is meant for fast changing properties like "time-pos", where a client
+ * does not need every single update.
+ *
+ * If min_interval is set, the property is read at most once every
+ * min_interval seconds. Changes within this time are coalesced, and reported
+ * as a single event once the interval has passed. (This does not apply while
+ * hooks are waiting for property changes to be drained.)
+ *
+ * If min_delta is set, and both the previously reported and the new value are
+ * numbers (MPV_FORMAT_INT64, MPV_FORMAT_DOUBLE, or a MPV_FORMAT_NODE holding
+ * one of these), a change is only reported if the absolute difference is at
+ * least min_delta. Other changes (e.g. the property becoming unavailable) are
+ * always reported.
+ *
+ * Suppressed changes do not generate events, and the core does not even read
+ * the property while it is rate-limited.
+ *
+ * mpv_unobserve_property() works as usual.
+ *
+ * Safe to be called from mpv render API threads.
+ *
+ * @param min_interval minimum time between events in seconds, or 0
+ * @param min_delta minimum change of numeric values to report, or 0
+ * @return error code (MPV_ERROR_INVALID_PARAMETER if any of the limits is
+ *         negative or NaN)
+ */
+int mpv_observe_property_limited(mpv_handle *mpv, uint64_t reply_userdata,
+                                 const char *name, mpv_format format,
+                                 double min_interval, double min_delta);
+
 /**
  * Undo mpv_observe_property(). This will remove all observed properties for
  * which the given number was passed as reply_userdata to mpv_observe_property.
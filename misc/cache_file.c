@@ -0,0 +1,91 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <libavutil/mem.h>
+#include <libavutil/sha.h>
+
+#include "common/common.h"
+#include "options/path.h"
+#include "osdep/getpid.h"
+#include "osdep/io.h"
+#include "osdep/threads.h"
+#include "cache_file.h"
+
+// Return the name of the cache file for key in dir. The name is the SHA-256
+// of the key, so arbitrary keys (like file paths) can be used.
+char *mp_cache_file_path(void *ta_ctx, const char *dir, bstr key)
+{
+    struct AVSHA *sha = av_sha_alloc();
+    MP_HANDLE_OOM(sha);
+    av_sha_init(sha, 256);
+    av_sha_update(sha, key.start, key.len);
+    uint8_t hash[256 / 8];
+    av_sha_final(sha, hash);
+    av_free(sha);
+
+    char name[256 / 8 * 2 + 1];
+    for (int n = 0; n < 256 / 8; n++)
+        snprintf(name + n * 2, 3, "%02X", hash[n]);
+
+    return mp_path_join(ta_ctx, dir, name);
+}
+
+// Return a string that identifies the current contents of the regular file at
+// path, or NULL if it can't be accessed. Cache entries are valid only if they
+// were written with the same stamp. The modification time is used with full
+// precision where available, so that changes within a second are detected.
+char *mp_cache_file_stamp(void *ta_ctx, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) || !S_ISREG(st.st_mode))
+        return NULL;
+    long nsec = 0;
+#if defined(__APPLE__)
+    nsec = st.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+    nsec = st.st_mtim.tv_nsec;
+#endif
+    return talloc_asprintf(ta_ctx, "%lld %lld.%09ld", (long long)st.st_size,
+                           (long long)st.st_mtime, nsec);
+}
+
+// Replace the file with the given contents, creating its directory if needed.
+// Other processes may be writing the same file concurrently, so this makes
+// sure that readers never see a partially written file.
+bool mp_cache_file_write(const char *filename, bstr data)
+{
+    void *tmp = talloc_new(NULL);
+    char *tmpname = talloc_asprintf(tmp, "%s.%d.%"PRIu64".tmp", filename,
+                                    (int)mp_getpid(), mpthread_get_id());
+    mp_mkdirp(bstrto0(tmp, mp_dirname(filename)));
+    FILE *out = fopen(tmpname, "wb");
+    bool ok = out && (!data.len || fwrite(data.start, data.len, 1, out) == 1);
+    if (out)
+        ok &= fclose(out) == 0;
+    if (ok)
+        ok = rename(tmpname, filename) == 0;
+    if (!ok && out)
+        unlink(tmpname);
+    talloc_free(tmp);
+    return ok;
+}
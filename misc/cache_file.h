@@ -0,0 +1,12 @@
+#ifndef MP_CACHE_FILE_H_
+#define MP_CACHE_FILE_H_
+
+#include <stdbool.h>
+
+#include "misc/bstr.h"
+
+char *mp_cache_file_path(void *ta_ctx, const char *dir, bstr key);
+char *mp_cache_file_stamp(void *ta_ctx, const char *path);
+bool mp_cache_file_write(const char *filename, bstr data);
+
+#endif
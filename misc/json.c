@@ -78,7 +78,90 @@ void json_skip_whitespace(char **src)
     eat_ws(src);
 }
 
-static int read_id(void *ta_parent, struct mpv_node *dst, char **src)
+/* Arena for json_parse_arena(). Memory is allocated in blocks, which are kept
+ * on json_arena_reset(), so parsing similar input over and over eventually
+ * stops allocating.
+ */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+struct arena_block {
+    char *data;
+    size_t size;
+};
+
+struct json_arena {
+    struct arena_block *blocks;
+    int num_blocks;
+    int cur_block;
+    size_t cur_pos;
+    // List items of all lists currently being parsed (innermost last).
+    struct mpv_node *stack;
+    char **stack_keys;
+    int num_stack;
+    // Scratch buffer for unescaping strings.
+    bstr scratch;
+    uint64_t num_allocs;
+};
+
+struct json_arena *json_arena_create(void *ta_parent)
+{
+    return talloc_zero(ta_parent, struct json_arena);
+}
+
+// Make all memory returned by previous json_parse_arena() calls available for
+// reuse. The nodes returned by them become invalid.
+void json_arena_reset(struct json_arena *a)
+{
+    a->cur_block = 0;
+    a->cur_pos = 0;
+    a->num_stack = 0;
+}
+
+// Number of heap allocations the arena made so far.
+uint64_t json_arena_get_num_allocs(struct json_arena *a)
+{
+    return a->num_allocs;
+}
+
+static void *arena_alloc(struct json_arena *a, size_t size)
+{
+    size = MP_ALIGN_UP(size, 16);
+    while (a->cur_block < a->num_blocks) {
+        struct arena_block *b = &a->blocks[a->cur_block];
+        if (b->size - a->cur_pos >= size) {
+            void *r = b->data + a->cur_pos;
+            a->cur_pos += size;
+            return r;
+        }
+        a->cur_block++;
+        a->cur_pos = 0;
+    }
+    struct arena_block b = {.size = MPMAX(size, ARENA_BLOCK_SIZE)};
+    b.data = talloc_size(a, b.size);
+    a->num_allocs += 1 + (a->num_blocks >= MP_TALLOC_AVAIL(a->blocks));
+    MP_TARRAY_APPEND(a, a->blocks, a->num_blocks, b);
+    a->cur_block = a->num_blocks - 1;
+    a->cur_pos = size;
+    return b.data;
+}
+
+// Allocate from the arena if it's set, from ta_parent otherwise.
+static char *p_strndup(struct json_arena *a, void *ta_parent, const char *s,
+                       size_t len)
+{
+    if (!a)
+        return talloc_strndup(ta_parent, s, len);
+    char *r = arena_alloc(a, len + 1);
+    memcpy(r, s, len);
+    r[len] = '\0';
+    return r;
+}
+
+static int parse(struct json_arena *a, void *ta_parent, struct mpv_node *dst,
+                 char **src, int max_depth);
+
+static int read_id(struct json_arena *a, void *ta_parent, struct mpv_node *dst,
+                   char **src)
 {
     char *start = *src;
     if (!mp_isalpha(**src) && **src != '_')
@@ -89,14 +172,15 @@ static int read_id(void *ta_parent, struct mpv_node *dst, char **src)
         **src = '\0'; // we're allowed to mutate it => can avoid the strndup
         *src += 1;
     } else {
-        start = talloc_strndup(ta_parent, start, *src - start);
+        start = p_strndup(a, ta_parent, start, *src - start);
     }
     dst->format = MPV_FORMAT_STRING;
     dst->u.string = start;
     return 0;
 }
 
-static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
+static int read_str(struct json_arena *a, void *ta_parent, struct mpv_node *dst,
+                    char **src)
 {
     if (!eat_c(src, '"'))
         return -1; // not a string
@@ -119,72 +203,104 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     cur[0] = '\0';
     *src = cur + 1;
     if (has_escapes) {
-        bstr unescaped = {0};
         bstr r = bstr0(str);
-        if (!mp_append_escaped_string(ta_parent, &unescaped, &r))
-            return -1; // broken escapes
-        str = unescaped.start; // the function guarantees null-termination
+        if (a) {
+            size_t old_size = a->scratch.start ? talloc_get_size(a->scratch.start) : 0;
+            a->scratch.len = 0;
+            if (!mp_append_escaped_string(a, &a->scratch, &r))
+                return -1; // broken escapes
+            a->num_allocs += talloc_get_size(a->scratch.start) != old_size;
+            str = p_strndup(a, NULL, a->scratch.start, a->scratch.len);
+        } else {
+            bstr unescaped = {0};
+            if (!mp_append_escaped_string(ta_parent, &unescaped, &r))
+                return -1; // broken escapes
+            str = unescaped.start; // the function guarantees null-termination
+        }
     }
     dst->format = MPV_FORMAT_STRING;
     dst->u.string = str;
     return 0;
 }
 
-static int read_sub(void *ta_parent, struct mpv_node *dst, char **src,
-                    int max_depth)
+static int read_sub(struct json_arena *a, void *ta_parent, struct mpv_node *dst,
+                    char **src, int max_depth)
 {
     bool is_arr = eat_c(src, '[');
     bool is_obj = !is_arr && eat_c(src, '{');
     if (!is_arr && !is_obj)
         return -1; // not an array or object
     char term = is_obj ? '}' : ']';
-    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    // With an arena, items are collected on a shared stack, and copied into a
+    // list of the exact size at the end. Otherwise the list is grown directly.
+    struct mpv_node_list *list =
+        a ? NULL : talloc_zero(ta_parent, struct mpv_node_list);
+    int base = a ? a->num_stack : 0;
+    int num = 0;
     while (1) {
         eat_ws(src);
         if (eat_c(src, term))
             break;
-        if (list->num > 0 && !eat_c(src, ','))
+        if (num > 0 && !eat_c(src, ','))
             return -1; // missing ','
         eat_ws(src);
         // non-standard extension: allow a trailing ","
         if (eat_c(src, term))
             break;
+        char *key = NULL;
         if (is_obj) {
             struct mpv_node keynode;
             // non-standard extension: allow unquoted strings as keys
-            if (read_id(list, &keynode, src) < 0 &&
-                read_str(list, &keynode, src) < 0)
+            if (read_id(a, list, &keynode, src) < 0 &&
+                read_str(a, list, &keynode, src) < 0)
                 return -1; // key is not a string
             eat_ws(src);
             // non-standard extension: allow "=" instead of ":"
             if (!eat_c(src, ':') && !eat_c(src, '='))
                 return -1; // ':' missing
             eat_ws(src);
-            MP_TARRAY_GROW(list, list->keys, list->num);
-            list->keys[list->num] = keynode.u.string;
+            key = keynode.u.string;
         }
-        MP_TARRAY_GROW(list, list->values, list->num);
-        if (json_parse(ta_parent, &list->values[list->num], src, max_depth) < 0)
+        struct mpv_node val;
+        if (parse(a, ta_parent, &val, src, max_depth) < 0)
             return -1;
-        list->num++;
+        if (a) {
+            if (a->num_stack >= MP_TALLOC_AVAIL(a->stack))
+                a->num_allocs += 2;
+            MP_TARRAY_GROW(a, a->stack, a->num_stack);
+            MP_TARRAY_GROW(a, a->stack_keys, a->num_stack);
+            a->stack[a->num_stack] = val;
+            a->stack_keys[a->num_stack] = key;
+            a->num_stack++;
+        } else {
+            if (is_obj) {
+                MP_TARRAY_GROW(list, list->keys, list->num);
+                list->keys[list->num] = key;
+            }
+            MP_TARRAY_GROW(list, list->values, list->num);
+            list->values[list->num] = val;
+            list->num++;
+        }
+        num++;
+    }
+    if (a) {
+        list = arena_alloc(a, sizeof(*list));
+        *list = (struct mpv_node_list){.num = num};
+        list->values = arena_alloc(a, num * sizeof(list->values[0]));
+        memcpy(list->values, a->stack + base, num * sizeof(list->values[0]));
+        if (is_obj) {
+            list->keys = arena_alloc(a, num * sizeof(list->keys[0]));
+            memcpy(list->keys, a->stack_keys + base, num * sizeof(list->keys[0]));
+        }
+        a->num_stack = base;
     }
     dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
     dst->u.list = list;
     return 0;
 }
 
-/* Parse the string in *src as JSON, and write the result into *dst.
- * max_depth limits the recursion and JSON tree depth.
- * Warning: this overwrites the input string (what *src points to)!
- * Returns:
- *   0: success, *dst is valid, *src points to the end (the caller must check
- *      whether *src really terminates)
- *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
- *      (ta_free_children(ta_parent) is the only way to free them)
- * The input string can be mutated in both cases. *dst might contain string
- * elements, which point into the (mutated) input string.
- */
-int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
+static int parse(struct json_arena *a, void *ta_parent, struct mpv_node *dst,
+                 char **src, int max_depth)
 {
     max_depth -= 1;
     if (max_depth < 0)
@@ -210,9 +326,9 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
         dst->u.flag = 0;
         return 0;
     } else if (c == '"') {
-        return read_str(ta_parent, dst, src);
+        return read_str(a, ta_parent, dst, src);
     } else if (c == '[' || c == '{') {
-        return read_sub(ta_parent, dst, src, max_depth);
+        return read_sub(a, ta_parent, dst, src, max_depth);
     } else if (c == '-' || (c >= '0' && c <= '9')) {
         // The number could be either a float or an int. JSON doesn't make a
         // difference, but the client API does.
@@ -242,6 +358,32 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
     return -1; // character doesn't start a valid token
 }
 
+/* Parse the string in *src as JSON, and write the result into *dst.
+ * max_depth limits the recursion and JSON tree depth.
+ * Warning: this overwrites the input string (what *src points to)!
+ * Returns:
+ *   0: success, *dst is valid, *src points to the end (the caller must check
+ *      whether *src really terminates)
+ *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
+ *      (ta_free_children(ta_parent) is the only way to free them)
+ * The input string can be mutated in both cases. *dst might contain string
+ * elements, which point into the (mutated) input string.
+ */
+int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
+{
+    return parse(NULL, ta_parent, dst, src, max_depth);
+}
+
+/* Like json_parse(), but allocate all memory from the arena. *dst stays valid
+ * until the next json_arena_reset() call (or until the arena is freed). This
+ * can be called multiple times between resets.
+ */
+int json_parse_arena(struct json_arena *arena, struct mpv_node *dst, char **src,
+                     int max_depth)
+{
+    arena->num_stack = 0;
+    return parse(arena, NULL, dst, src, max_depth);
+}
 
 #define APPEND(b, s) bstr_xappend(NULL, (b), bstr0(s))
 
@@ -268,9 +410,11 @@ static void write_json_str(bstr *b, unsigned char *str)
         } else if (cur[0] == '\\') {
             bstr_xappend(NULL, b, (bstr){"\\\\", 2});
         } else if (cur[0] < sizeof(special_escape) && special_escape[cur[0]]) {
-            bstr_xappend_asprintf(NULL, b, "\\%c", special_escape[cur[0]]);
+            bstr_xappend(NULL, b, (bstr){(char[]){'\\', special_escape[cur[0]]}, 2});
         } else {
-            bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)cur[0]);
+            APPEND(b, buf);
         }
         str = cur + 1;
     }
@@ -296,12 +440,23 @@ static int json_append(bstr *b, const struct mpv_node *src, int indent)
     case MPV_FORMAT_FLAG:
         APPEND(b, src->u.flag ? "true" : "false");
         return 0;
-    case MPV_FORMAT_INT64:
-        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+    case MPV_FORMAT_INT64: {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%"PRId64, src->u.int64);
+        APPEND(b, buf);
         return 0;
+    }
     case MPV_FORMAT_DOUBLE: {
+        // Avoid bstr_xappend_asprintf(), which allocates a temporary string.
+        // "%f" is only unbounded for huge values, so fall back for these.
         const char *px = isfinite(src->u.double_) ? "" : "\"";
-        bstr_xappend_asprintf(NULL, b, "%s%f%s", px, src->u.double_, px);
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "%s%f%s", px, src->u.double_, px);
+        if (len >= 0 && len < sizeof(buf)) {
+            bstr_xappend(NULL, b, (bstr){buf, len});
+        } else {
+            bstr_xappend_asprintf(NULL, b, "%s%f%s", px, src->u.double_, px);
+        }
         return 0;
     }
     case MPV_FORMAT_STRING:
@@ -339,6 +494,16 @@ static int json_append_str(char **dst, struct mpv_node *src, int indent)
     return r;
 }
 
+/* Append the contents of *src as JSON to *dst. dst->start must be a talloc
+ * allocation or NULL. Unlike json_write(), this doesn't need strlen(), so
+ * reusing a buffer (by setting dst->len to 0) is cheap.
+ * Returns: 0 on success, <0 on failure.
+ */
+int json_write_bstr(bstr *dst, const struct mpv_node *src)
+{
+    return json_append(dst, src, -1);
+}
+
 /* Write the contents of *src as JSON, and append the JSON string to *dst.
  * This will use strlen() to determine the start offset, and ta_get_size()
  * and ta_realloc() to extend the memory allocation of *dst.
@@ -18,12 +18,23 @@
 #ifndef MP_JSON_H
 #define MP_JSON_H
 
+#include <stdint.h>
+
 // We reuse mpv_node.
 #include "libmpv/client.h"
+#include "misc/bstr.h"
 
 int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth);
 void json_skip_whitespace(char **src);
 int json_write(char **s, struct mpv_node *src);
 int json_write_pretty(char **s, struct mpv_node *src);
+int json_write_bstr(bstr *dst, const struct mpv_node *src);
+
+struct json_arena;
+struct json_arena *json_arena_create(void *ta_parent);
+void json_arena_reset(struct json_arena *arena);
+uint64_t json_arena_get_num_allocs(struct json_arena *arena);
+int json_parse_arena(struct json_arena *arena, struct mpv_node *dst, char **src,
+                     int max_depth);
 
 #endif
@@ -0,0 +1,340 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack reader and writer for mpv_node.
+ *
+ * Mapping:
+ *  nil         <-> MPV_FORMAT_NONE
+ *  bool        <-> MPV_FORMAT_FLAG
+ *  int         <-> MPV_FORMAT_INT64 (unsigned values > INT64_MAX are rejected)
+ *  float       <-> MPV_FORMAT_DOUBLE (float 32 is accepted on input)
+ *  str         <-> MPV_FORMAT_STRING (truncated at the first 0 byte)
+ *  bin         <-> MPV_FORMAT_BYTE_ARRAY
+ *  array       <-> MPV_FORMAT_NODE_ARRAY
+ *  map         <-> MPV_FORMAT_NODE_MAP (keys must be strings)
+ *
+ * Extension types are rejected. The writer always uses the shortest encoding.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <string.h>
+
+#include <libavutil/intfloat.h>
+#include <libavutil/intreadwrite.h>
+
+#include "common/common.h"
+#include "misc/msgpack.h"
+
+static bool read_bytes(bstr *src, void *dst, size_t size)
+{
+    if (src->len < size)
+        return false;
+    memcpy(dst, src->start, size);
+    *src = bstr_cut(*src, size);
+    return true;
+}
+
+// Read a big endian unsigned integer with the given size in bytes.
+static bool read_uint(bstr *src, int size, uint64_t *out)
+{
+    uint8_t b[8];
+    if (!read_bytes(src, b, size))
+        return false;
+    switch (size) {
+    case 1: *out = b[0]; break;
+    case 2: *out = AV_RB16(b); break;
+    case 4: *out = AV_RB32(b); break;
+    case 8: *out = AV_RB64(b); break;
+    default: return false;
+    }
+    return true;
+}
+
+static int parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                 int max_depth);
+
+static int read_str(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t len)
+{
+    if (len > src->len)
+        return -1;
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = talloc_strndup(ta_parent, src->start, len);
+    *src = bstr_cut(*src, len);
+    return 0;
+}
+
+static int read_bin(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t len)
+{
+    if (len > src->len)
+        return -1;
+    struct mpv_byte_array *ba = talloc_zero(ta_parent, struct mpv_byte_array);
+    ba->data = talloc_memdup(ba, src->start, len);
+    ba->size = len;
+    dst->format = MPV_FORMAT_BYTE_ARRAY;
+    dst->u.ba = ba;
+    *src = bstr_cut(*src, len);
+    return 0;
+}
+
+static int read_sub(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t num, bool is_obj, int max_depth)
+{
+    // Each item needs at least 1 byte (2 for map entries); this rejects
+    // bogus sizes before allocating anything.
+    if (num > src->len)
+        return -1;
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    list->values = talloc_array(list, struct mpv_node, num);
+    if (is_obj)
+        list->keys = talloc_array(list, char *, num);
+    for (uint64_t n = 0; n < num; n++) {
+        if (is_obj) {
+            struct mpv_node keynode;
+            if (parse(list, &keynode, src, max_depth) < 0 ||
+                keynode.format != MPV_FORMAT_STRING)
+                return -1; // key is not a string
+            list->keys[n] = keynode.u.string;
+        }
+        if (parse(list, &list->values[n], src, max_depth) < 0)
+            return -1;
+        list->num++;
+    }
+    dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+    return 0;
+}
+
+static int parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                 int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    uint8_t c;
+    if (!read_bytes(src, &c, 1))
+        return -1;
+
+    uint64_t v;
+
+    if (c <= 0x7f) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = c;
+        return 0;
+    } else if (c >= 0xe0) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int8_t)c;
+        return 0;
+    } else if ((c & 0xf0) == 0x80) {
+        return read_sub(ta_parent, dst, src, c & 0x0f, true, max_depth);
+    } else if ((c & 0xf0) == 0x90) {
+        return read_sub(ta_parent, dst, src, c & 0x0f, false, max_depth);
+    } else if ((c & 0xe0) == 0xa0) {
+        return read_str(ta_parent, dst, src, c & 0x1f);
+    }
+
+    switch (c) {
+    case 0xc0:
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = c == 0xc3;
+        return 0;
+    case 0xc4: case 0xc5: case 0xc6:
+        if (!read_uint(src, 1 << (c - 0xc4), &v))
+            return -1;
+        return read_bin(ta_parent, dst, src, v);
+    case 0xca:
+        if (!read_uint(src, 4, &v))
+            return -1;
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = av_int2float(v);
+        return 0;
+    case 0xcb:
+        if (!read_uint(src, 8, &v))
+            return -1;
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = av_int2double(v);
+        return 0;
+    case 0xcc: case 0xcd: case 0xce: case 0xcf:
+        if (!read_uint(src, 1 << (c - 0xcc), &v) || v > INT64_MAX)
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = v;
+        return 0;
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+        int size = 1 << (c - 0xd0);
+        if (!read_uint(src, size, &v))
+            return -1;
+        // Sign extend.
+        if (size < 8 && (v & (1ULL << (size * 8 - 1))))
+            v |= ~0ULL << (size * 8);
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int64_t)v;
+        return 0;
+    }
+    case 0xd9: case 0xda: case 0xdb:
+        if (!read_uint(src, 1 << (c - 0xd9), &v))
+            return -1;
+        return read_str(ta_parent, dst, src, v);
+    case 0xdc: case 0xdd:
+        if (!read_uint(src, 2 << (c - 0xdc), &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, false, max_depth);
+    case 0xde: case 0xdf:
+        if (!read_uint(src, 2 << (c - 0xde), &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, true, max_depth);
+    }
+
+    return -1; // reserved, or an extension type
+}
+
+/* Parse one MessagePack value from the start of *src, and write the result
+ * into *dst. max_depth limits the recursion and tree depth.
+ * Returns:
+ *   0: success, *dst is valid, *src is advanced past the value (the caller
+ *      must check whether there is trailing data)
+ *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
+ * Unlike json_parse(), the input is not modified, and all strings are copied.
+ */
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth)
+{
+    return parse(ta_parent, dst, src, max_depth);
+}
+
+static void write_byte(bstr *b, uint8_t v)
+{
+    bstr_xappend(NULL, b, (bstr){&v, 1});
+}
+
+// Write a type byte, followed by v as a big endian integer of the given size.
+static void write_head(bstr *b, uint8_t type, int size, uint64_t v)
+{
+    uint8_t buf[9] = {type};
+    switch (size) {
+    case 1: buf[1] = v; break;
+    case 2: AV_WB16(buf + 1, v); break;
+    case 4: AV_WB32(buf + 1, v); break;
+    case 8: AV_WB64(buf + 1, v); break;
+    }
+    bstr_xappend(NULL, b, (bstr){buf, 1 + size});
+}
+
+// Write the header of a variable length type. fix_type/fix_max are for the
+// compact form (0 if it has none), type8 is the type byte for a 8 bit length
+// (0 if none), and type16 and type32 must follow each other.
+static void write_len(bstr *b, uint64_t len, uint8_t fix_type, int fix_max,
+                      uint8_t type8, uint8_t type16)
+{
+    if (fix_type && len <= fix_max) {
+        write_byte(b, fix_type | len);
+    } else if (type8 && len <= UINT8_MAX) {
+        write_head(b, type8, 1, len);
+    } else if (len <= UINT16_MAX) {
+        write_head(b, type16, 2, len);
+    } else {
+        write_head(b, type16 + 1, 4, len);
+    }
+}
+
+static void write_int(bstr *b, int64_t v)
+{
+    if (v >= -32 && v <= 127) {
+        write_byte(b, (uint8_t)v);
+    } else if (v > 0) {
+        if (v <= UINT8_MAX) {
+            write_head(b, 0xcc, 1, v);
+        } else if (v <= UINT16_MAX) {
+            write_head(b, 0xcd, 2, v);
+        } else if (v <= UINT32_MAX) {
+            write_head(b, 0xce, 4, v);
+        } else {
+            write_head(b, 0xcf, 8, v);
+        }
+    } else if (v >= INT8_MIN) {
+        write_head(b, 0xd0, 1, (uint8_t)v);
+    } else if (v >= INT16_MIN) {
+        write_head(b, 0xd1, 2, (uint16_t)v);
+    } else if (v >= INT32_MIN) {
+        write_head(b, 0xd2, 4, (uint32_t)v);
+    } else {
+        write_head(b, 0xd3, 8, (uint64_t)v);
+    }
+}
+
+static void write_str(bstr *b, const char *s)
+{
+    size_t len = strlen(s);
+    write_len(b, len, 0xa0, 31, 0xd9, 0xda);
+    bstr_xappend(NULL, b, (bstr){(char *)s, len});
+}
+
+/* Append the contents of *src as MessagePack to *dst. dst->start must be a
+ * talloc allocation or NULL.
+ * Returns: 0 on success, <0 on failure (*dst may contain partial output).
+ */
+int msgpack_write(bstr *dst, const struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_byte(dst, 0xc0);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_byte(dst, src->u.flag ? 0xc3 : 0xc2);
+        return 0;
+    case MPV_FORMAT_INT64:
+        write_int(dst, src->u.int64);
+        return 0;
+    case MPV_FORMAT_DOUBLE:
+        write_head(dst, 0xcb, 8, av_double2int(src->u.double_));
+        return 0;
+    case MPV_FORMAT_STRING:
+        write_str(dst, src->u.string);
+        return 0;
+    case MPV_FORMAT_BYTE_ARRAY: {
+        struct mpv_byte_array *ba = src->u.ba;
+        write_len(dst, ba->size, 0, 0, 0xc4, 0xc5);
+        bstr_xappend(NULL, dst, (bstr){ba->data, ba->size});
+        return 0;
+    }
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_obj = src->format == MPV_FORMAT_NODE_MAP;
+        if (is_obj) {
+            write_len(dst, list->num, 0x80, 15, 0, 0xde);
+        } else {
+            write_len(dst, list->num, 0x90, 15, 0, 0xdc);
+        }
+        for (int n = 0; n < list->num; n++) {
+            if (is_obj)
+                write_str(dst, list->keys[n]);
+            if (msgpack_write(dst, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
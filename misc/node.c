@@ -144,5 +144,7 @@ bool equal_mpv_node(const struct mpv_node *a, const struct mpv_node *b)
 {
     if (a->format != b->format)
         return false;
+    if (a->format == MPV_FORMAT_BYTE_ARRAY)
+        return equal_mpv_value(a->u.ba, b->u.ba, a->format);
     return equal_mpv_value(&a->u, &b->u, a->format);
 }
@@ -107,10 +107,7 @@ static void cancel_destroy(void *p)
 
     mp_cancel_set_parent(c, NULL);
 
-    if (c->wakeup_pipe[0] >= 0) {
-        close(c->wakeup_pipe[0]);
-        close(c->wakeup_pipe[1]);
-    }
+    mp_close_wakeup_fd(c->wakeup_pipe);
 
 #ifdef __MINGW32__
     if (c->win32_event)
@@ -146,8 +143,7 @@ static void trigger_locked(struct mp_cancel *c)
     for (struct mp_cancel *sub = c->slaves.head; sub; sub = sub->siblings.next)
         mp_cancel_trigger(sub);
 
-    if (c->wakeup_pipe[1] >= 0)
-        (void)write(c->wakeup_pipe[1], &(char){0}, 1);
+    mp_signal_wakeup_fd(c->wakeup_pipe);
 
 #ifdef __MINGW32__
     if (c->win32_event)
@@ -245,7 +241,7 @@ int mp_cancel_get_fd(struct mp_cancel *c)
 {
     pthread_mutex_lock(&c->lock);
     if (c->wakeup_pipe[0] < 0) {
-        mp_make_wakeup_pipe(c->wakeup_pipe);
+        mp_make_wakeup_fd(c->wakeup_pipe);
         retrigger_locked(c);
     }
     pthread_mutex_unlock(&c->lock);
@@ -87,6 +87,7 @@ struct config_cache {
     bool in_list;                   // part of m_config_shadow->listeners[]
     int upd_group;                  // for "incremental" change notification
     int upd_opt;
+    uint64_t upd_ts;                // src ts of upd_group when its scan began
 
 
     // --- Implicitly synchronized by setting/unsetting wakeup_cb.
@@ -103,6 +104,8 @@ struct config_cache {
 struct m_group_data {
     char *udata;        // pointer to group user option struct
     uint64_t ts;        // timestamp of the data copy
+    uint64_t *opt_ts;   // timestamp of the last change of each option (only
+                        // allocated for the shadow copy, indexed like opts)
 };
 
 static const union m_option_value default_value = {0};
@@ -338,6 +341,10 @@ static void alloc_group(struct m_config_data *data, int group_index,
         .ts = copy_gdata ? copy_gdata->ts : 0,
     };
 
+    // Only the shadow copy is created without copying, and needs this.
+    if (!copy)
+        gdata->opt_ts = talloc_zero_array(data, uint64_t, group->opt_count);
+
     if (opts->defaults)
         memcpy(gdata->udata, opts->defaults, opts->size);
 
@@ -609,7 +616,18 @@ static void update_next_option(struct m_config_cache *cache, void **p_opt)
             struct m_config_group *g = &dst->shadow->groups[in->upd_group];
             const struct m_option *opts = g->group->opts;
 
-            while (opts && opts[in->upd_opt].name) {
+            // Options changed after this are compared on the next update.
+            if (in->upd_opt == 0)
+                in->upd_ts = gsrc->ts;
+
+            while (in->upd_opt < g->opt_count) {
+                // Options not written since our copy can't have changed, so
+                // skip them without looking at the option itself.
+                if (gsrc->opt_ts[in->upd_opt] <= gdst->ts) {
+                    in->upd_opt++;
+                    continue;
+                }
+
                 const struct m_option *opt = &opts[in->upd_opt];
 
                 if (opt->offset >= 0 && opt->type->size) {
@@ -642,7 +660,7 @@ static void update_next_option(struct m_config_cache *cache, void **p_opt)
                 in->upd_opt++;
             }
 
-            gdst->ts = gsrc->ts;
+            gdst->ts = in->upd_ts;
         }
 
         in->upd_group++;
@@ -757,6 +775,7 @@ bool m_config_cache_write_opt(struct m_config_cache *cache, void *ptr)
         m_option_copy(opt, gsrc->udata + opt->offset, ptr);
 
         gsrc->ts = atomic_fetch_add(&shadow->ts, 1) + 1;
+        gsrc->opt_ts[opt_idx] = gsrc->ts;
 
         for (int n = 0; n < shadow->num_listeners; n++) {
             struct config_cache *listener = shadow->listeners[n];
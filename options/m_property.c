@@ -37,7 +37,7 @@
 #include "common/common.h"
 
 static int m_property_multiply(struct mp_log *log,
-                               const struct m_property *prop_list,
+                               const struct m_property_index *prop_list,
                                const char *property, double f, void *ctx)
 {
     union m_option_value val = {0};
@@ -72,16 +72,82 @@ struct m_property *m_property_list_find(const struct m_property *list,
     return NULL;
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
+struct m_property_index {
+    const struct m_property *list;
+    int *table;         // index into list, or -1 for empty slots
+    uint32_t mask;      // table size - 1 (table size is a power of 2)
+};
+
+// FNV-1a
+static uint32_t hash_name(const char *name, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t n = 0; n < len; n++) {
+        h ^= (unsigned char)name[n];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Create a hash table for looking up entries of the given list by name. The
+// list must not be changed or freed while the index is in use. If names are
+// duplicated, the first entry wins (like m_property_list_find()).
+struct m_property_index *m_property_index_new(void *ta_parent,
+                                              const struct m_property *list)
+{
+    struct m_property_index *idx = talloc_zero(ta_parent, struct m_property_index);
+    idx->list = list;
+
+    int num = 0;
+    while (list[num].name)
+        num++;
+
+    // Keep the load factor at or below 0.5.
+    uint32_t size = 16;
+    while (size < num * 2)
+        size *= 2;
+    idx->mask = size - 1;
+    idx->table = talloc_array(idx, int, size);
+    for (uint32_t n = 0; n < size; n++)
+        idx->table[n] = -1;
+
+    for (int n = 0; n < num; n++) {
+        const char *name = list[n].name;
+        size_t len = strlen(name);
+        if (m_property_index_find(idx, name, len))
+            continue;
+        uint32_t slot = hash_name(name, len) & idx->mask;
+        while (idx->table[slot] >= 0)
+            slot = (slot + 1) & idx->mask;
+        idx->table[slot] = n;
+    }
+
+    return idx;
+}
+
+// Return the entry with the given name (which has len bytes and does not need
+// to be 0-terminated), or NULL.
+struct m_property *m_property_index_find(const struct m_property_index *idx,
+                                         const char *name, size_t len)
+{
+    uint32_t slot = hash_name(name, len) & idx->mask;
+    while (idx->table[slot] >= 0) {
+        const struct m_property *prop = &idx->list[idx->table[slot]];
+        if (strncmp(prop->name, name, len) == 0 && !prop->name[len])
+            return (struct m_property *)prop;
+        slot = (slot + 1) & idx->mask;
+    }
+    return NULL;
+}
+
+static int do_action(const struct m_property_index *prop_list, const char *name,
                      int action, void *arg, void *ctx)
 {
     struct m_property *prop;
     struct m_property_action_arg ka;
     const char *sep = strchr(name, '/');
     if (sep && sep[1]) {
-        char base[128];
-        snprintf(base, sizeof(base), "%.*s", (int)(sep - name), name);
-        prop = m_property_list_find(prop_list, base);
+        prop = m_property_index_find(prop_list, name, sep - name);
         ka = (struct m_property_action_arg) {
             .key = sep + 1,
             .action = action,
@@ -90,14 +156,14 @@ static int do_action(const struct m_property *prop_list, const char *name,
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
     } else
-        prop = m_property_list_find(prop_list, name);
+        prop = m_property_index_find(prop_list, name, strlen(name));
     if (!prop)
         return M_PROPERTY_UNKNOWN;
     return prop->call(ctx, prop, action, arg);
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_index *prop_list,
                   const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = {0};
@@ -236,7 +302,7 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(const struct m_property_index *prop_list, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
@@ -254,7 +320,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
+static int expand_property(const struct m_property_index *prop_list, char **ret,
                            int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
@@ -285,7 +351,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
+char *m_properties_expand_string(const struct m_property_index *prop_list,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
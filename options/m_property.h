@@ -138,11 +138,18 @@ struct m_property {
 struct m_property *m_property_list_find(const struct m_property *list,
                                         const char *name);
 
+// Hash table over a property list, which m_property_do() uses for lookups.
+struct m_property_index;
+struct m_property_index *m_property_index_new(void *ta_parent,
+                                              const struct m_property *list);
+struct m_property *m_property_index_find(const struct m_property_index *idx,
+                                         const char *name, size_t len);
+
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_index *prop_list,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -167,7 +174,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_index *prop_list,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
@@ -41,6 +41,7 @@
 #include "stream/stream.h"
 #include "video/csputils.h"
 #include "video/hwdec.h"
+#include "video/image_arena.h"
 #include "video/image_writer.h"
 #include "sub/osd.h"
 #include "player/core.h"
@@ -63,6 +64,7 @@ extern const struct m_sub_options stream_lavf_conf;
 extern const struct m_sub_options sws_conf;
 extern const struct m_sub_options zimg_conf;
 extern const struct m_sub_options drm_conf;
+extern const struct m_sub_options lua_conf;
 extern const struct m_sub_options demux_rawaudio_conf;
 extern const struct m_sub_options demux_rawvideo_conf;
 extern const struct m_sub_options demux_lavf_conf;
@@ -77,6 +79,7 @@ extern const struct m_sub_options ao_alsa_conf;
 
 extern const struct m_sub_options demux_conf;
 extern const struct m_sub_options demux_cache_conf;
+extern const struct m_sub_options demux_probe_cache_conf;
 
 extern const struct m_obj_list vf_obj_list;
 extern const struct m_obj_list af_obj_list;
@@ -395,6 +398,9 @@ static const m_option_t mp_opts[] = {
         .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"dump-stats", OPT_STRING(dump_stats),
         .flags = UPDATE_TERM | CONF_PRE_PARSE | M_OPT_FILE},
+    {"dump-stats-format", OPT_CHOICE(dump_stats_format,
+        {"text", 0}, {"trace", 1}),
+        .flags = UPDATE_TERM | CONF_PRE_PARSE},
     {"msg-color", OPT_FLAG(msg_color), .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"log-file", OPT_STRING(log_file),
         .flags = CONF_PRE_PARSE | M_OPT_FILE | UPDATE_TERM},
@@ -421,6 +427,7 @@ static const m_option_t mp_opts[] = {
     {"script", OPT_CLI_ALIAS("scripts-append")},
     {"script-opts", OPT_KEYVALUELIST(script_opts)},
     {"load-scripts", OPT_FLAG(auto_load_scripts)},
+    {"lazy-load-scripts", OPT_FLAG(lazy_load_scripts)},
 #endif
 #if HAVE_LUA
     {"osc", OPT_FLAG(lua_load_osc), .flags = UPDATE_BUILTIN_SCRIPTS},
@@ -434,6 +441,7 @@ static const m_option_t mp_opts[] = {
     {"load-auto-profiles",
         OPT_CHOICE(lua_load_auto_profiles, {"no", 0}, {"yes", 1}, {"auto", -1}),
         .flags = UPDATE_BUILTIN_SCRIPTS},
+    {"", OPT_SUBSTRUCT(lua_opts, lua_conf)},
 #endif
 
 // ------------------------- stream options --------------------
@@ -648,6 +656,12 @@ static const m_option_t mp_opts[] = {
         {"decoder", 2},
         {"decoder+vo", 3})},
     {"video-latency-hacks", OPT_FLAG(video_latency_hacks)},
+    {"image-pool-max-bytes", OPT_BYTE_SIZE(image_pool_max_bytes),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
+    {"image-pool-hugepages", OPT_CHOICE(image_pool_hugepages,
+        {"no", MP_IMAGE_ARENA_OFF},
+        {"thp", MP_IMAGE_ARENA_THP},
+        {"hugetlb", MP_IMAGE_ARENA_HUGETLB})},
 
     {"untimed", OPT_FLAG(untimed)},
 
@@ -734,8 +748,11 @@ static const m_option_t mp_opts[] = {
     {"input-terminal", OPT_FLAG(consolecontrols), .flags = UPDATE_TERM},
 
     {"input-ipc-server", OPT_STRING(ipc_path), .flags = M_OPT_FILE},
+    {"input-ipc-server-mode", OPT_CHOICE(ipc_server_mode,
+        {"threads", 0}, {"event-loop", 1})},
 #if HAVE_POSIX
     {"input-ipc-client", OPT_STRING(ipc_client)},
+    {"shared-state-file", OPT_STRING(shared_state_path), .flags = M_OPT_FILE},
 #endif
 
     {"screenshot", OPT_SUBSTRUCT(screenshot_image_opts, screenshot_conf)},
@@ -753,6 +770,7 @@ static const m_option_t mp_opts[] = {
     {"", OPT_SUBSTRUCT(vo, vo_sub_opts)},
     {"", OPT_SUBSTRUCT(demux_opts, demux_conf)},
     {"", OPT_SUBSTRUCT(demux_cache_opts, demux_cache_conf)},
+    {"", OPT_SUBSTRUCT(demux_probe_cache_opts, demux_probe_cache_conf)},
     {"", OPT_SUBSTRUCT(stream_opts, stream_conf)},
 
     {"", OPT_SUBSTRUCT(gl_video_opts, gl_video_conf)},
@@ -957,6 +975,7 @@ static const struct MPOpts mp_default_opts = {
     .lua_load_auto_profiles = -1,
 #endif
     .auto_load_scripts = 1,
+    .lazy_load_scripts = 1,
     .loop_times = 1,
     .ordered_chapters = 1,
     .chapter_merge_threshold = 100,
@@ -989,6 +1008,7 @@ static const struct MPOpts mp_default_opts = {
     .keep_open = 0,
     .keep_open_pause = 1,
     .image_display_duration = 1.0,
+    .image_pool_max_bytes = 256 * 1024 * 1024,
     .stream_id = { { [STREAM_AUDIO] = -1,
                      [STREAM_VIDEO] = -1,
                      [STREAM_SUB] = -1, },
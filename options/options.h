@@ -126,6 +126,7 @@ typedef struct MPOpts {
     int property_print_help;
     int use_terminal;
     char *dump_stats;
+    int dump_stats_format;
     int verbose;
     int msg_really_quiet;
     char **msg_levels;
@@ -147,8 +148,10 @@ typedef struct MPOpts {
     int lua_load_stats;
     int lua_load_console;
     int lua_load_auto_profiles;
+    struct lua_opts *lua_opts;
 
     int auto_load_scripts;
+    int lazy_load_scripts;
 
     int audio_exclusive;
     int ao_null_fallback;
@@ -218,6 +221,8 @@ typedef struct MPOpts {
     int autosync;
     int frame_dropping;
     int video_latency_hacks;
+    int64_t image_pool_max_bytes;
+    int image_pool_hugepages;
     int term_osd;
     int term_osd_bar;
     char *term_osd_bar_chars;
@@ -315,6 +320,7 @@ typedef struct MPOpts {
 
     struct demux_opts *demux_opts;
     struct demux_cache_opts *demux_cache_opts;
+    struct demux_probe_cache_opts *demux_probe_cache_opts;
     struct stream_opts *stream_opts;
 
     struct vd_lavc_params *vd_lavc_params;
@@ -326,7 +332,9 @@ typedef struct MPOpts {
     struct encode_opts *encode_opts;
 
     char *ipc_path;
+    int ipc_server_mode;
     char *ipc_client;
+    char *shared_state_path;
 
     int wingl_dwm_flush;
 
@@ -32,6 +32,10 @@
 #include "mpv_talloc.h"
 
 #include "config.h"
+
+#if HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
 #include "osdep/io.h"
 #include "osdep/terminal.h"
 
@@ -109,6 +113,45 @@ void mp_flush_wakeup_pipe(int pipe_end)
 #endif
 }
 
+// Like mp_make_wakeup_pipe(), but use an eventfd if available. Then both
+// entries are the same FD, and a wakeup is a single 8 byte counter update
+// instead of going through a pipe buffer. fds[0] is always the end for poll()
+// and mp_flush_wakeup_pipe(). Use mp_signal_wakeup_fd() to write to it, and
+// mp_close_wakeup_fd() to close it.
+int mp_make_wakeup_fd(int fds[2])
+{
+#if HAVE_EVENTFD
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd >= 0) {
+        fds[0] = fds[1] = fd;
+        return 0;
+    }
+#endif
+    return mp_make_wakeup_pipe(fds);
+}
+
+void mp_signal_wakeup_fd(int fds[2])
+{
+#ifndef __MINGW32__
+    if (fds[1] < 0)
+        return;
+    if (fds[0] == fds[1]) {
+        (void)write(fds[1], &(uint64_t){1}, sizeof(uint64_t));
+    } else {
+        (void)write(fds[1], &(char){0}, 1);
+    }
+#endif
+}
+
+void mp_close_wakeup_fd(int fds[2])
+{
+    if (fds[0] >= 0)
+        close(fds[0]);
+    if (fds[1] >= 0 && fds[1] != fds[0])
+        close(fds[1]);
+    fds[0] = fds[1] = -1;
+}
+
 #ifdef _WIN32
 
 #include <windows.h>
@@ -76,6 +76,9 @@ bool mp_set_cloexec(int fd);
 int mp_make_cloexec_pipe(int pipes[2]);
 int mp_make_wakeup_pipe(int pipes[2]);
 void mp_flush_wakeup_pipe(int pipe_end);
+int mp_make_wakeup_fd(int fds[2]);
+void mp_signal_wakeup_fd(int fds[2]);
+void mp_close_wakeup_fd(int fds[2]);
 
 #ifdef _WIN32
 #include <wchar.h>
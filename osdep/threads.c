@@ -18,6 +18,12 @@
 #include <stdio.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 
 #include "common/common.h"
 #include "config.h"
@@ -54,6 +60,23 @@ void mpthread_set_name(const char *name)
 #endif
 }
 
+#ifdef __linux__
+static __thread uint64_t cached_thread_id;
+#endif
+
+uint64_t mpthread_get_id(void)
+{
+#ifdef __linux__
+    // The kernel thread ID, as shown by tools like top or perf. Cached, since
+    // this is called for every stats line.
+    if (!cached_thread_id)
+        cached_thread_id = syscall(SYS_gettid);
+    return cached_thread_id;
+#else
+    return (uintptr_t)pthread_self();
+#endif
+}
+
 int mp_ptwrap_check(const char *file, int line, int res)
 {
     if (res && res != ETIMEDOUT) {
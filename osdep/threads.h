@@ -10,6 +10,9 @@ int mpthread_mutex_init_recursive(pthread_mutex_t *mutex);
 // Set thread name (for debuggers).
 void mpthread_set_name(const char *name);
 
+// Return a number identifying the calling thread (for logging).
+uint64_t mpthread_get_id(void);
+
 int mp_ptwrap_check(const char *file, int line, int res);
 int mp_ptwrap_mutex_init(const char *file, int line, pthread_mutex_t *m,
                          const pthread_mutexattr_t *attr);
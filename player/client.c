@@ -27,6 +27,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "input/input.h"
 #include "input/cmd.h"
 #include "misc/ctype.h"
@@ -84,6 +85,21 @@ struct mp_client_api {
 
     struct mpv_render_context *render_context;
     struct mpv_opengl_cb_context *gl_cb_ctx;
+
+    // -- core thread only
+    // Values read during the current mp_client_send_property_changes() call.
+    struct prop_value **prop_cache;
+    int num_prop_cache;
+};
+
+// Result of reading a property with a specific format. This is immutable once
+// created, and shared by all observers of the same property and format.
+struct prop_value {
+    atomic_int refcount;
+    char *name;
+    mpv_format format;
+    bool valid;
+    union m_option_value value;
 };
 
 struct observe_property {
@@ -94,16 +110,23 @@ struct observe_property {
     uint64_t event_mask;    // ==mp_get_property_event_mask(name)
     int64_t reply_id;
     mpv_format format;
-    const struct m_option *type;
+    double min_interval;    // minimum time between reads (seconds)
+    double min_delta;       // minimum numeric change to report
     // -- protected by owner->lock
     size_t refcount;
     uint64_t change_ts;     // logical timestamp incremented on each change
     uint64_t value_ts;      // logical timestamp for value contents
-    bool value_valid;
-    union m_option_value value;
+    struct prop_value *value;
     uint64_t value_ret_ts;  // logical timestamp of value returned to user
-    union m_option_value value_ret;
+    struct prop_value *value_ret;
     bool waiting_for_hook;  // flag for draining old property changes on a hook
+    double next_read;       // mp_time_sec() before which reads are deferred
+};
+
+// Entry in mpv_handle.events.
+struct event_slot {
+    atomic_bool ready;      // event was written, and can be read
+    struct mpv_event event;
 };
 
 struct mpv_handle {
@@ -130,18 +153,23 @@ struct mpv_handle {
     void *wakeup_cb_ctx;
     int wakeup_pipe[2];
 
+    // -- event queue; see claim_event()
+    struct event_slot *events; // ringbuffer of max_events entries
+    int max_events;         // allocated number of entries in events
+    atomic_int used_events; // readable, reserved, or being written entries
+    atomic_int reserved_events; // number of entries reserved for replies
+    mp_atomic_uint64 write_event; // next entry to write (producers)
+    uint64_t read_event;    // next entry to read (consumer; protected by lock)
+    atomic_bool choked;     // recovering from queue overflow
+    atomic_int dropped_events; // number of events lost while choked
+    mp_atomic_uint64 event_mask;
+    mp_atomic_uint64 property_event_masks; // or-ed together event masks of all properties
+
     // -- protected by lock
 
-    uint64_t event_mask;
     bool queued_wakeup;
 
-    mpv_event *events;      // ringbuffer of max_events entries
-    int max_events;         // allocated number of entries in events
-    int first_event;        // events[first_event] is the first readable event
-    int num_events;         // number of readable events
-    int reserved_events;    // number of entries reserved for replies
     size_t async_counter;   // pending other async events
-    bool choked;            // recovering from queue overflow
     bool destroying;        // pending destruction; no API accesses allowed
     bool hook_pending;      // hook events are returned after draining properties
 
@@ -150,13 +178,17 @@ struct mpv_handle {
     bool has_pending_properties; // (maybe) new property events (producer side)
     bool new_property_events; // new property events (consumer side)
     int cur_property_index; // round-robin for property events (consumer side)
-    uint64_t property_event_masks; // or-ed together event masks of all properties
     // This is incremented whenever the properties[] array above changes. This
     // is used to safely unlock mpv_handle.lock while reading a property. If
     // the counter didn't change between unlock and relock, then it will assume
     // the array did not change.
     uint64_t properties_change_ts;
 
+    // Set between mp_client_begin_batch() and mp_client_end_batch(). While
+    // set, batch_thread holds the core lock on behalf of this handle.
+    bool batch_active;
+    pthread_t batch_thread;
+
     bool fuzzy_initialized; // see scripting.c wait_loaded()
     bool is_weak;           // can not keep core alive on its own
     struct mp_log_buffer *messages;
@@ -166,6 +198,8 @@ struct mpv_handle {
 static bool gen_log_message_event(struct mpv_handle *ctx);
 static bool gen_property_change_event(struct mpv_handle *ctx);
 static void notify_property_events(struct mpv_handle *ctx, int event);
+static struct event_slot *peek_event(struct mpv_handle *ctx);
+static void pop_event(struct mpv_handle *ctx);
 
 // Must be called with prop->owner->lock held.
 static void prop_unref(struct observe_property *prop)
@@ -294,9 +328,9 @@ struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name
         .clients = clients,
         .id = ++(clients->id_alloc),
         .cur_event = talloc_zero(client, struct mpv_event),
-        .events = talloc_array(client, mpv_event, num_events),
+        .events = talloc_zero_array(client, struct event_slot, num_events),
         .max_events = num_events,
-        .event_mask = (1ULL << INTERNAL_EVENT_BASE) - 1, // exclude internal events
+        .event_mask = ATOMIC_VAR_INIT((1ULL << INTERNAL_EVENT_BASE) - 1), // exclude internal events
         .wakeup_pipe = {-1, -1},
     };
     pthread_mutex_init(&client->lock, NULL);
@@ -353,8 +387,7 @@ static void wakeup_client(struct mpv_handle *ctx)
         pthread_cond_broadcast(&ctx->wakeup);
         if (ctx->wakeup_cb)
             ctx->wakeup_cb(ctx->wakeup_cb_ctx);
-        if (ctx->wakeup_pipe[0] != -1)
-            (void)write(ctx->wakeup_pipe[1], &(char){0}, 1);
+        mp_signal_wakeup_fd(ctx->wakeup_pipe);
     }
     pthread_mutex_unlock(&ctx->wakeup_lock);
 }
@@ -395,20 +428,56 @@ void mpv_resume(mpv_handle *ctx)
 {
 }
 
+// Whether the calling thread already holds the core lock because of
+// mp_client_begin_batch().
+static bool in_batch(mpv_handle *ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    bool r = ctx->batch_active && pthread_equal(ctx->batch_thread, pthread_self());
+    pthread_mutex_unlock(&ctx->lock);
+    return r;
+}
+
 static void lock_core(mpv_handle *ctx)
 {
-    mp_dispatch_lock(ctx->mpctx->dispatch);
+    if (!in_batch(ctx))
+        mp_dispatch_lock(ctx->mpctx->dispatch);
 }
 
 static void unlock_core(mpv_handle *ctx)
 {
+    if (!in_batch(ctx))
+        mp_dispatch_unlock(ctx->mpctx->dispatch);
+}
+
+// Lock the core until mp_client_end_batch(). API calls made on ctx from the
+// calling thread in between reuse this lock instead of locking the core for
+// each call. (Other threads are blocked as usual.) Commands which finish
+// asynchronously temporarily release the lock while they are waited on.
+// Must not be nested.
+void mp_client_begin_batch(mpv_handle *ctx)
+{
+    assert(!in_batch(ctx));
+    mp_dispatch_lock(ctx->mpctx->dispatch);
+    pthread_mutex_lock(&ctx->lock);
+    ctx->batch_active = true;
+    ctx->batch_thread = pthread_self();
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void mp_client_end_batch(mpv_handle *ctx)
+{
+    assert(in_batch(ctx));
+    pthread_mutex_lock(&ctx->lock);
+    ctx->batch_active = false;
+    pthread_mutex_unlock(&ctx->lock);
     mp_dispatch_unlock(ctx->mpctx->dispatch);
 }
 
 void mpv_wait_async_requests(mpv_handle *ctx)
 {
     pthread_mutex_lock(&ctx->lock);
-    while (ctx->reserved_events || ctx->async_counter)
+    while (atomic_load(&ctx->reserved_events) || ctx->async_counter)
         wait_wakeup(ctx, INT64_MAX);
     pthread_mutex_unlock(&ctx->lock);
 }
@@ -485,19 +554,16 @@ static void mp_destroy_client(mpv_handle *ctx, bool terminate)
         if (clients->clients[n] == ctx) {
             clients->clients_list_change_ts += 1;
             MP_TARRAY_REMOVE_AT(clients->clients, clients->num_clients, n);
-            while (ctx->num_events) {
-                talloc_free(ctx->events[ctx->first_event].data);
-                ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-                ctx->num_events--;
+            struct event_slot *slot;
+            while ((slot = peek_event(ctx))) {
+                talloc_free(slot->event.data);
+                pop_event(ctx);
             }
             mp_msg_log_buffer_destroy(ctx->messages);
             pthread_cond_destroy(&ctx->wakeup);
             pthread_mutex_destroy(&ctx->wakeup_lock);
             pthread_mutex_destroy(&ctx->lock);
-            if (ctx->wakeup_pipe[0] != -1) {
-                close(ctx->wakeup_pipe[0]);
-                close(ctx->wakeup_pipe[1]);
-            }
+            mp_close_wakeup_fd(ctx->wakeup_pipe);
             talloc_free(ctx);
             ctx = NULL;
             break;
@@ -716,57 +782,92 @@ static void dup_event_data(struct mpv_event *ev)
     }
 }
 
+// The event queue is a bounded multi-producer single-consumer ringbuffer,
+// which can be written without taking mpv_handle.lock. This way the core never
+// has to wait for a client which is busy in mpv_wait_event(). The consumer is
+// the thread calling mpv_wait_event() (which must not be called concurrently).
+//
+// A producer first claims an entry with claim_event(), which fails if the
+// queue is full. After that, push_event() can't fail: it takes the next write
+// position, copies the event, and marks the entry as ready. Entries can become
+// ready out of order; the consumer stops at the first entry that isn't ready
+// yet, and the producer that writes it wakes up the consumer.
+static bool claim_event(struct mpv_handle *ctx)
+{
+    int used = atomic_load(&ctx->used_events);
+    while (used < ctx->max_events) {
+        if (atomic_compare_exchange_strong(&ctx->used_events, &used, used + 1))
+            return true;
+    }
+    return false;
+}
+
+// The entry must have been claimed before.
+static void push_event(struct mpv_handle *ctx, struct mpv_event event)
+{
+    uint64_t pos = atomic_fetch_add(&ctx->write_event, 1);
+    struct event_slot *slot = &ctx->events[pos % ctx->max_events];
+    slot->event = event;
+    atomic_store(&slot->ready, true);
+}
+
+// Return the next readable entry, or NULL. Consumer only.
+static struct event_slot *peek_event(struct mpv_handle *ctx)
+{
+    struct event_slot *slot = &ctx->events[ctx->read_event % ctx->max_events];
+    return atomic_load(&slot->ready) ? slot : NULL;
+}
+
+// Remove the entry returned by peek_event(). Consumer only.
+static void pop_event(struct mpv_handle *ctx)
+{
+    struct event_slot *slot = &ctx->events[ctx->read_event % ctx->max_events];
+    atomic_store(&slot->ready, false);
+    ctx->read_event++;
+    atomic_fetch_add(&ctx->used_events, -1);
+}
+
 // Reserve an entry in the ring buffer. This can be used to guarantee that the
 // reply can be made, even if the buffer becomes congested _after_ sending
 // the request.
 // Returns an error code if the buffer is full.
 static int reserve_reply(struct mpv_handle *ctx)
 {
-    int res = MPV_ERROR_EVENT_QUEUE_FULL;
-    pthread_mutex_lock(&ctx->lock);
-    if (ctx->reserved_events + ctx->num_events < ctx->max_events && !ctx->choked)
-    {
-        ctx->reserved_events++;
-        res = 0;
-    }
-    pthread_mutex_unlock(&ctx->lock);
-    return res;
-}
-
-static int append_event(struct mpv_handle *ctx, struct mpv_event event, bool copy)
-{
-    if (ctx->num_events + ctx->reserved_events >= ctx->max_events)
-        return -1;
-    if (copy)
-        dup_event_data(&event);
-    ctx->events[(ctx->first_event + ctx->num_events) % ctx->max_events] = event;
-    ctx->num_events++;
-    wakeup_client(ctx);
-    if (event.event_id == MPV_EVENT_SHUTDOWN)
-        ctx->event_mask &= ctx->event_mask & ~(1ULL << MPV_EVENT_SHUTDOWN);
+    if (atomic_load(&ctx->choked) || !claim_event(ctx))
+        return MPV_ERROR_EVENT_QUEUE_FULL;
+    atomic_fetch_add(&ctx->reserved_events, 1);
     return 0;
 }
 
 static int send_event(struct mpv_handle *ctx, struct mpv_event *event, bool copy)
 {
-    pthread_mutex_lock(&ctx->lock);
     uint64_t mask = 1ULL << event->event_id;
-    if (ctx->property_event_masks & mask)
+    if (atomic_load(&ctx->property_event_masks) & mask) {
+        pthread_mutex_lock(&ctx->lock);
         notify_property_events(ctx, event->event_id);
-    int r;
-    if (!(ctx->event_mask & mask)) {
-        r = 0;
-    } else if (ctx->choked) {
-        r = -1;
-    } else {
-        r = append_event(ctx, *event, copy);
-        if (r < 0) {
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    if (!(atomic_load(&ctx->event_mask) & mask))
+        return 0;
+    // MPV_EVENT_SHUTDOWN is sent only once. Test and clear the mask bit in one
+    // atomic operation, so that concurrent senders can't both queue it.
+    bool shutdown = event->event_id == MPV_EVENT_SHUTDOWN;
+    if (shutdown && !(atomic_fetch_and(&ctx->event_mask, ~mask) & mask))
+        return 0;
+    if (atomic_load(&ctx->choked) || !claim_event(ctx)) {
+        if (!atomic_exchange(&ctx->choked, true))
             MP_ERR(ctx, "Too many events queued.\n");
-            ctx->choked = true;
-        }
+        atomic_fetch_add(&ctx->dropped_events, 1);
+        if (shutdown)
+            atomic_fetch_or(&ctx->event_mask, mask); // allow sending it again
+        return -1;
     }
-    pthread_mutex_unlock(&ctx->lock);
-    return r;
+    struct mpv_event ev = *event;
+    if (copy)
+        dup_event_data(&ev);
+    push_event(ctx, ev);
+    wakeup_client(ctx);
+    return 0;
 }
 
 // Send a reply; the reply must have been previously reserved with
@@ -775,12 +876,14 @@ static void send_reply(struct mpv_handle *ctx, uint64_t userdata,
                        struct mpv_event *event)
 {
     event->reply_userdata = userdata;
+    // The lock is needed because mpv_wait_async_requests() may destroy the
+    // handle as soon as reserved_events reaches 0.
     pthread_mutex_lock(&ctx->lock);
     // If this fails, reserve_reply() probably wasn't called.
-    assert(ctx->reserved_events > 0);
-    ctx->reserved_events--;
-    if (append_event(ctx, *event, false) < 0)
-        abort(); // not reached
+    int reserved = atomic_fetch_add(&ctx->reserved_events, -1);
+    assert(reserved > 0);
+    push_event(ctx, *event);
+    wakeup_client(ctx);
     pthread_mutex_unlock(&ctx->lock);
 }
 
@@ -882,16 +985,18 @@ int mpv_request_event(mpv_handle *ctx, mpv_event_id event, int enable)
     if (event == MPV_EVENT_SHUTDOWN && !enable)
         return MPV_ERROR_INVALID_PARAMETER;
     assert(event < (int)INTERNAL_EVENT_BASE); // excluded above; they have no name
-    pthread_mutex_lock(&ctx->lock);
     uint64_t bit = 1ULL << event;
-    ctx->event_mask = enable ? ctx->event_mask | bit : ctx->event_mask & ~bit;
+    if (enable) {
+        atomic_fetch_or(&ctx->event_mask, bit);
+    } else {
+        atomic_fetch_and(&ctx->event_mask, ~bit);
+    }
     if (enable && event < MP_ARRAY_SIZE(deprecated_events) &&
         deprecated_events[event])
     {
         MP_WARN(ctx, "The '%s' event is deprecated and will be removed.\n",
                 mpv_event_name(event));
     }
-    pthread_mutex_unlock(&ctx->lock);
     return 0;
 }
 
@@ -937,14 +1042,18 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
     while (1) {
         if (ctx->queued_wakeup)
             deadline = 0;
+        struct event_slot *slot = peek_event(ctx);
         // Recover from overflow.
-        if (ctx->choked && !ctx->num_events) {
-            ctx->choked = false;
+        if (!slot && atomic_load(&ctx->choked) &&
+            atomic_load(&ctx->used_events) == atomic_load(&ctx->reserved_events))
+        {
+            atomic_store(&ctx->choked, false);
+            MP_WARN(ctx, "%d events were dropped.\n",
+                    atomic_exchange(&ctx->dropped_events, 0));
             event->event_id = MPV_EVENT_QUEUE_OVERFLOW;
             break;
         }
-        struct mpv_event *ev =
-            ctx->num_events ? &ctx->events[ctx->first_event] : NULL;
+        struct mpv_event *ev = slot ? &slot->event : NULL;
         if (ev && ev->event_id == MPV_EVENT_HOOK) {
             // Give old property notifications priority over hooks. This is a
             // guarantee given to clients to simplify their logic. New property
@@ -961,8 +1070,7 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
         }
         if (ev) {
             *event = *ev;
-            ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-            ctx->num_events--;
+            pop_event(ctx);
             talloc_steal(event, event->data);
             break;
         }
@@ -1085,9 +1193,9 @@ int mpv_set_option_string(mpv_handle *ctx, const char *name, const char *data)
 // Run a command in the playback thread.
 static void run_locked(mpv_handle *ctx, void (*fn)(void *fn_data), void *fn_data)
 {
-    mp_dispatch_lock(ctx->mpctx->dispatch);
+    lock_core(ctx);
     fn(fn_data);
-    mp_dispatch_unlock(ctx->mpctx->dispatch);
+    unlock_core(ctx);
 }
 
 // Run a command asynchronously. It's the responsibility of the caller to
@@ -1162,8 +1270,17 @@ static int run_client_command(mpv_handle *ctx, struct mp_cmd *cmd, mpv_node *res
     }
     unlock_core(ctx);
 
-    if (!async)
-        mp_waiter_wait(&req.completion);
+    if (!async) {
+        // The command may need the core thread to make progress, so a batch
+        // can't keep it locked while waiting.
+        if (in_batch(ctx) && !mp_waiter_poll(&req.completion)) {
+            mp_dispatch_unlock(ctx->mpctx->dispatch);
+            mp_waiter_wait(&req.completion);
+            mp_dispatch_lock(ctx->mpctx->dispatch);
+        } else {
+            mp_waiter_wait(&req.completion);
+        }
+    }
 
     return req.status;
 }
@@ -1542,20 +1659,86 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, getproperty_fn, req);
 }
 
+static void prop_value_free(void *p)
+{
+    struct prop_value *v = p;
+
+    if (v->valid)
+        m_option_free(get_mp_type_get(v->format), &v->value);
+}
+
+static struct prop_value *prop_value_ref(struct prop_value *v)
+{
+    if (v)
+        atomic_fetch_add(&v->refcount, 1);
+    return v;
+}
+
+// Can be called from any thread.
+static void prop_value_unref(struct prop_value *v)
+{
+    if (v && atomic_fetch_add(&v->refcount, -1) == 1)
+        talloc_free(v);
+}
+
+// Read the property, or return a new reference to the value that was already
+// read for another observer during the current mp_client_send_property_changes()
+// call. Must be called on the core thread.
+static struct prop_value *read_shared_value(struct MPContext *mpctx,
+                                            const char *name, mpv_format format)
+{
+    struct mp_client_api *clients = mpctx->clients;
+
+    for (int n = 0; n < clients->num_prop_cache; n++) {
+        struct prop_value *v = clients->prop_cache[n];
+        if (v->format == format && strcmp(v->name, name) == 0) {
+            stats_event(mpctx->stats, "property-reads-shared");
+            return prop_value_ref(v);
+        }
+    }
+
+    struct prop_value *v = talloc_ptrtype(NULL, v);
+    talloc_set_destructor(v, prop_value_free);
+    *v = (struct prop_value){
+        .refcount = ATOMIC_VAR_INIT(1),
+        .name = talloc_strdup(v, name),
+        .format = format,
+    };
+
+    struct getproperty_request req = {
+        .mpctx = mpctx,
+        .name = name,
+        .format = format,
+        .data = &v->value,
+    };
+    getproperty_fn(&req);
+    v->valid = req.status >= 0;
+    stats_event(mpctx->stats, "property-reads");
+
+    MP_TARRAY_APPEND(clients, clients->prop_cache, clients->num_prop_cache,
+                     prop_value_ref(v));
+    return v;
+}
+
 static void property_free(void *p)
 {
     struct observe_property *prop = p;
 
     assert(prop->refcount == 0);
 
-    if (prop->type) {
-        m_option_free(prop->type, &prop->value);
-        m_option_free(prop->type, &prop->value_ret);
-    }
+    prop_value_unref(prop->value);
+    prop_value_unref(prop->value_ret);
 }
 
 int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
                          const char *name, mpv_format format)
+{
+    return mpv_observe_property_limited(ctx, userdata, name, format, 0, 0);
+}
+
+int mpv_observe_property_limited(mpv_handle *ctx, uint64_t userdata,
+                                 const char *name, mpv_format format,
+                                 double min_interval, double min_delta)
 {
     const struct m_option *type = get_mp_type_get(format);
     if (format != MPV_FORMAT_NONE && !type)
@@ -1563,6 +1746,8 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     // Explicitly disallow this, because it would require a special code path.
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
+    if (!(min_interval >= 0) || !(min_delta >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
 
     pthread_mutex_lock(&ctx->lock);
     assert(!ctx->destroying);
@@ -1575,13 +1760,14 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
         .event_mask = mp_get_property_event_mask(name),
         .reply_id = userdata,
         .format = format,
-        .type = type,
+        .min_interval = min_interval,
+        .min_delta = min_delta,
         .change_ts = 1, // force initial event
         .refcount = 1,
     };
     ctx->properties_change_ts += 1;
     MP_TARRAY_APPEND(ctx, ctx->properties, ctx->num_properties, prop);
-    ctx->property_event_masks |= prop->event_mask;
+    atomic_fetch_or(&ctx->property_event_masks, prop->event_mask);
     ctx->new_property_events = true;
     ctx->cur_property_index = 0;
     ctx->has_pending_properties = true;
@@ -1659,10 +1845,31 @@ static void notify_property_events(struct mpv_handle *ctx, int event)
         mp_dispatch_adjust_timeout(ctx->mpctx->dispatch, 0);
 }
 
+// Return whether v contains a number, and write it to *out.
+static bool get_numeric_value(struct prop_value *v, double *out)
+{
+    if (!v || !v->valid)
+        return false;
+    struct mpv_node node = {.format = v->format};
+    if (v->format == MPV_FORMAT_NODE) {
+        node = *(struct mpv_node *)&v->value;
+    } else if (v->format == MPV_FORMAT_INT64) {
+        node.u.int64 = v->value.int64;
+    } else if (v->format == MPV_FORMAT_DOUBLE) {
+        node.u.double_ = v->value.double_;
+    }
+    switch (node.format) {
+    case MPV_FORMAT_INT64:  *out = node.u.int64; return true;
+    case MPV_FORMAT_DOUBLE: *out = node.u.double_; return true;
+    }
+    return false;
+}
+
 // Call with ctx->lock held (only). May temporarily drop the lock.
 static void send_client_property_changes(struct mpv_handle *ctx)
 {
     uint64_t cur_ts = ctx->properties_change_ts;
+    double now = 0;
 
     ctx->has_pending_properties = false;
 
@@ -1672,17 +1879,20 @@ static void send_client_property_changes(struct mpv_handle *ctx)
         if (prop->value_ts == prop->change_ts)
             continue;
 
+        // Rate-limited: leave the change pending, and come back when the
+        // interval has passed. Don't hold back hooks waiting on this.
+        if (prop->min_interval > 0 && !prop->waiting_for_hook) {
+            if (!now)
+                now = mp_time_sec();
+            if (now < prop->next_read) {
+                mp_set_timeout(ctx->mpctx, prop->next_read - now);
+                ctx->has_pending_properties = true;
+                continue;
+            }
+        }
+
         bool changed = false;
         if (prop->format) {
-            const struct m_option *type = prop->type;
-            union m_option_value val = {0};
-            struct getproperty_request req = {
-                .mpctx = ctx->mpctx,
-                .name = prop->name,
-                .format = prop->format,
-                .data = &val,
-            };
-
             // Temporarily unlock and read the property. The very important
             // thing is that property getters can do whatever they want, _and_
             // that they may wait on the client API user thread (if vo_libmpv
@@ -1690,7 +1900,8 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             prop->refcount += 1; // keep prop alive (esp. prop->name)
             ctx->async_counter += 1; // keep ctx alive
             pthread_mutex_unlock(&ctx->lock);
-            getproperty_fn(&req);
+            struct prop_value *val =
+                read_shared_value(ctx->mpctx, prop->name, prop->format);
             pthread_mutex_lock(&ctx->lock);
             ctx->async_counter -= 1;
             prop_unref(prop);
@@ -1698,29 +1909,35 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             // Set if observed properties was changed or something similar
             // => start over, retry next time.
             if (cur_ts != ctx->properties_change_ts || ctx->destroying) {
-                m_option_free(type, &val);
+                prop_value_unref(val);
                 mp_wakeup_core(ctx->mpctx);
                 ctx->has_pending_properties = true;
                 break;
             }
             assert(prop->refcount > 0);
 
-            bool val_valid = req.status >= 0;
-            changed = prop->value_valid != val_valid;
-            if (prop->value_valid && val_valid)
-                changed = !equal_mpv_value(&prop->value, &val, prop->format);
+            struct prop_value *old = prop->value;
+            changed = !old || old->valid != val->valid;
+            if (!changed && val->valid && old != val)
+                changed = !equal_mpv_value(&old->value, &val->value, prop->format);
+            double a, b;
+            if (changed && prop->min_delta > 0 && get_numeric_value(old, &a) &&
+                get_numeric_value(val, &b) && fabs(a - b) < prop->min_delta)
+                changed = false;
             if (prop->value_ts == 0)
                 changed = true; // initial event
 
-            prop->value_valid = val_valid;
-            if (changed && val_valid) {
-                // move val to prop->value
-                m_option_free(type, &prop->value);
-                memcpy(&prop->value, &val, type->type->size);
-                memset(&val, 0, type->type->size);
+            if (changed && prop->min_interval > 0) {
+                prop->next_read = (now ? now : mp_time_sec()) +
+                                  prop->min_interval;
             }
 
-            m_option_free(prop->type, &val);
+            if (changed) {
+                prop->value = val;
+                prop_value_unref(old);
+            } else {
+                prop_value_unref(val);
+            }
         } else {
             changed = true;
         }
@@ -1772,6 +1989,12 @@ void mp_client_send_property_changes(struct MPContext *mpctx)
     }
 
     pthread_mutex_unlock(&clients->lock);
+
+    // Values are shared only within a single call; the next call may see
+    // different property values.
+    for (int n = 0; n < clients->num_prop_cache; n++)
+        prop_value_unref(clients->prop_cache[n]);
+    clients->num_prop_cache = 0;
 }
 
 // Set ctx->cur_event to a generated property change event, if there is any
@@ -1801,13 +2024,16 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
             ctx->cur_property = prop;
             prop->refcount += 1;
 
-            if (prop->value_valid)
-                m_option_copy(prop->type, &prop->value_ret, &prop->value);
+            // The value is immutable, so the event can point into it directly.
+            prop_value_unref(prop->value_ret);
+            prop->value_ret = prop_value_ref(prop->value);
+            struct prop_value *val = prop->value_ret;
+            bool valid = val && val->valid;
 
             ctx->cur_property_event = (struct mpv_event_property){
                 .name = prop->name,
-                .format = prop->value_valid ? prop->format : 0,
-                .data = prop->value_valid ? &prop->value_ret : NULL,
+                .format = valid ? prop->format : 0,
+                .data = valid ? &val->value : NULL,
             };
             *ctx->cur_event = (struct mpv_event){
                 .event_id = MPV_EVENT_PROPERTY_CHANGE,
@@ -1927,8 +2153,10 @@ int mpv_get_wakeup_pipe(mpv_handle *ctx)
 {
     pthread_mutex_lock(&ctx->wakeup_lock);
     if (ctx->wakeup_pipe[0] == -1) {
+        // This is a public API, and clients may read it with any buffer
+        // size, so it must be a real pipe (not an eventfd).
         if (mp_make_wakeup_pipe(ctx->wakeup_pipe) >= 0)
-            (void)write(ctx->wakeup_pipe[1], &(char){0}, 1);
+            mp_signal_wakeup_fd(ctx->wakeup_pipe);
     }
     int fd = ctx->wakeup_pipe[0];
     pthread_mutex_unlock(&ctx->wakeup_lock);
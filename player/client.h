@@ -35,6 +35,8 @@ void mp_client_send_property_changes(struct MPContext *mpctx);
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name);
 void mp_client_set_weak(struct mpv_handle *ctx);
 struct mp_log *mp_client_get_log(struct mpv_handle *ctx);
+void mp_client_begin_batch(struct mpv_handle *ctx);
+void mp_client_end_batch(struct mpv_handle *ctx);
 struct mpv_global *mp_client_get_global(struct mpv_handle *ctx);
 
 void mp_client_broadcast_event_external(struct mp_client_api *api, int event,
@@ -57,6 +57,8 @@
 #include "video/out/vo.h"
 #include "video/csputils.h"
 #include "video/hwdec.h"
+#include "video/image_arena.h"
+#include "video/mp_image_pool.h"
 #include "audio/aframe.h"
 #include "audio/format.h"
 #include "audio/out/ao.h"
@@ -80,6 +82,7 @@
 struct command_ctx {
     // All properties, terminated with a {0} item.
     struct m_property *properties;
+    struct m_property_index *property_index;
 
     double last_seek_time;
     double last_seek_pts;
@@ -2539,6 +2542,23 @@ static int mp_property_perf_info(void *ctx, struct m_property *p, int action,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_startup_phases(void *ctx, struct m_property *p,
+                                      int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        stats_global_query_phases(mpctx->global, (struct mpv_node *)arg);
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 static int mp_property_vo(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -3543,6 +3563,7 @@ static const struct m_property mp_properties_base[] = {
     {"vo-configured", mp_property_vo_configured},
     {"vo-passes", mp_property_vo_passes},
     {"perf-info", mp_property_perf_info},
+    {"startup-phases", mp_property_startup_phases},
     {"current-vo", mp_property_vo},
     {"container-fps", mp_property_fps},
     {"estimated-vf-fps", mp_property_vf_fps},
@@ -3724,6 +3745,17 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
+
+    const char *base = name;
+    if (strncmp(base, "options/", 8) == 0)
+        base += 8;
+    const char *sep = strchr(base, '/');
+    size_t len = sep ? sep - base : strlen(base);
+    struct m_property *prop =
+        m_property_index_find(ctx->property_index, base, len);
+    if (prop)
+        return prop - ctx->properties;
+
     for (int n = 0; ctx->properties[n].name; n++) {
         if (match_property(ctx->properties[n].name, name))
             return n;
@@ -3753,7 +3785,7 @@ int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
     struct command_ctx *cmd = ctx->command_ctx;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, cmd->property_index, name, action, val, ctx);
 
     if (mp_msg_test(ctx->log, MSGL_V) && is_property_set(action, val)) {
         struct m_option ot = {0};
@@ -3778,7 +3810,7 @@ int mp_property_do(const char *name, int action, void *val,
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
+    return m_properties_expand_string(ctx->property_index, str, mpctx);
 }
 
 // Before expanding properties, parse C-style escapes like "\n"
@@ -5603,6 +5635,8 @@ static void cmd_script_binding(void *p)
     char state[3] = {'p', incmd->is_mouse_button ? 'm' : '-'};
     if (incmd->is_up_down)
         state[0] = incmd->repeated ? 'r' : (incmd->is_up ? 'u' : 'd');
+    mp_trigger_lazy_scripts(mpctx, target ? MP_LAZY_CLIENT : MP_LAZY_BINDING,
+                            target ? target : name);
     event.num_args = 5;
     event.args = (const char*[5]){"key-binding", name, state,
                                   incmd->key_name ? incmd->key_name : "",
@@ -5627,6 +5661,7 @@ static void cmd_script_message_to(void *p)
         MP_TARRAY_APPEND(event, event->args, event->num_args,
                          talloc_strdup(event, cmd->args[n].v.s));
     }
+    mp_trigger_lazy_scripts(mpctx, MP_LAZY_CLIENT, cmd->args[0].v.s);
     if (mp_client_send_event(mpctx, cmd->args[0].v.s, 0,
                                 MPV_EVENT_CLIENT_MESSAGE, event) < 0)
     {
@@ -5645,6 +5680,8 @@ static void cmd_script_message(void *p)
     mpv_event_client_message event = {.args = args};
     for (int n = 0; n < cmd->num_args; n++)
         event.args[event.num_args++] = cmd->args[n].v.s;
+    if (cmd->num_args)
+        mp_trigger_lazy_scripts(mpctx, MP_LAZY_MESSAGE, cmd->args[0].v.s);
     mp_client_broadcast_event(mpctx, MPV_EVENT_CLIENT_MESSAGE, &event);
     talloc_free(args);
 }
@@ -6039,7 +6076,7 @@ const struct mp_cmd_def mp_cmds[] = {
                 {"each-frame", 8}),
                 .flags = MP_CMD_OPT_ARG},
         },
-        .spawn_thread = true,
+        .exec_async = true,
     },
     { "screenshot-to-file", cmd_screenshot_to_file,
         {
@@ -6050,7 +6087,17 @@ const struct mp_cmd_def mp_cmds[] = {
                 {"subtitles", 2}),
                 OPTDEF_INT(2)},
         },
-        .spawn_thread = true,
+        .exec_async = true,
+    },
+    { "screenshot-sequence", cmd_screenshot_sequence,
+        {
+            {"interval", OPT_INT(v.i), M_RANGE(0, INT_MAX)},
+            {"flags", OPT_CHOICE(v.i,
+                {"video", 0},
+                {"window", 1},
+                {"subtitles", 2}),
+                OPTDEF_INT(2)},
+        },
     },
     { "screenshot-raw", cmd_screenshot_raw,
         {
@@ -6324,6 +6371,8 @@ void command_init(struct MPContext *mpctx)
 
         ctx->properties[count++] = prop;
     }
+
+    ctx->property_index = m_property_index_new(ctx, ctx->properties);
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
@@ -6367,6 +6416,7 @@ void mp_notify(struct MPContext *mpctx, int event, void *arg)
 
     command_event(mpctx, event, arg);
 
+    mp_trigger_lazy_scripts_event(mpctx, event);
     mp_client_broadcast_event(mpctx, event, arg);
 }
 
@@ -6428,11 +6478,18 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags,
     if (flags & UPDATE_INPUT)
         mp_input_update_opts(mpctx->input);
 
-    if (init || opt_ptr == &opts->ipc_path || opt_ptr == &opts->ipc_client) {
+    if (init || opt_ptr == &opts->ipc_path || opt_ptr == &opts->ipc_client ||
+        opt_ptr == &opts->ipc_server_mode)
+    {
         mp_uninit_ipc(mpctx->ipc_ctx);
         mpctx->ipc_ctx = mp_init_ipc(mpctx->clients, mpctx->global);
     }
 
+    if (init || opt_ptr == &opts->shared_state_path) {
+        mp_shared_state_uninit(mpctx->shared_state);
+        mpctx->shared_state = mp_shared_state_init(mpctx);
+    }
+
     if (flags & UPDATE_AUDIO)
         reload_audio_output(mpctx);
 
@@ -6509,6 +6566,12 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags,
     if (opt_ptr == &opts->cursor_autohide_delay)
         mpctx->mouse_timer = 0;
 
+    if (init || opt_ptr == &opts->image_pool_max_bytes)
+        mp_image_pool_set_max_idle_bytes(opts->image_pool_max_bytes);
+
+    if (init || opt_ptr == &opts->image_pool_hugepages)
+        mp_image_arena_set_mode(opts->image_pool_hugepages);
+
     if (flags & UPDATE_DVB_PROG) {
         if (!mpctx->stop_play)
             mpctx->stop_play = PT_CURRENT_ENTRY;
@@ -6553,5 +6616,6 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags,
 
 void mp_notify_property(struct MPContext *mpctx, const char *property)
 {
+    mp_trigger_lazy_scripts(mpctx, MP_LAZY_PROPERTY, property);
     mp_client_property_change(mpctx, property);
 }
@@ -444,8 +444,11 @@ typedef struct MPContext {
     struct encode_lavc_context *encode_lavc_ctx;
 
     struct mp_ipc_ctx *ipc_ctx;
+    struct mp_shared_state_ctx *shared_state;
 
     int64_t builtin_script_ids[5];
+    struct lazy_script **lazy_scripts;
+    int num_lazy_scripts;
 
     pthread_mutex_t abort_lock;
 
@@ -634,9 +637,22 @@ struct mp_scripting {
     bool no_thread;         // don't run load() on dedicated thread
     int (*load)(struct mp_script_args *args);
 };
+enum mp_lazy_trigger {
+    MP_LAZY_CLIENT,         // anything sent to the script's client name
+    MP_LAZY_BINDING,        // script-binding without script name
+    MP_LAZY_MESSAGE,        // broadcast script-message
+    MP_LAZY_PROPERTY,       // property change notification
+};
 bool mp_load_scripts(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
 int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname);
+void mp_trigger_lazy_scripts(struct MPContext *mpctx, int type, const char *name);
+void mp_trigger_lazy_scripts_event(struct MPContext *mpctx, int event);
+
+// shared_state.c
+struct mp_shared_state_ctx *mp_shared_state_init(struct MPContext *mpctx);
+void mp_shared_state_uninit(struct mp_shared_state_ctx *ctx);
+void mp_shared_state_update(struct MPContext *mpctx);
 
 // sub.c
 void reset_subtitle_state(struct MPContext *mpctx);
@@ -1042,6 +1042,7 @@ static void *open_demux_thread(void *ctx)
         .stream_flags = mpctx->open_url_flags,
         .stream_record = true,
         .is_top_level = true,
+        .record_phases = !mpctx->open_for_prefetch,
     };
     struct demuxer *demux =
         demux_open_url(mpctx->open_url, &p, mpctx->open_cancel, mpctx->global);
@@ -1438,6 +1439,9 @@ static void play_current_file(struct MPContext *mpctx)
 
     mp_notify(mpctx, MPV_EVENT_START_FILE, &start_event);
 
+    stats_phases_reset(mpctx->global);
+    stats_phase(mpctx->global, "start-file");
+
     mp_cancel_reset(mpctx->playback_abort);
 
     mpctx->error_playing = MPV_ERROR_LOADING_FAILED;
@@ -1595,10 +1599,14 @@ static void play_current_file(struct MPContext *mpctx)
 
     update_playback_speed(mpctx);
 
+    stats_phase(mpctx->global, "track-selection");
+
     reinit_video_chain(mpctx);
     reinit_audio_chain(mpctx);
     reinit_sub_all(mpctx);
 
+    stats_phase(mpctx->global, "decoder-init");
+
     if (mpctx->encode_lavc_ctx) {
         if (mpctx->vo_chain)
             encode_lavc_expect_stream(mpctx->encode_lavc_ctx, STREAM_VIDEO);
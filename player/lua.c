@@ -33,6 +33,7 @@
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "options/m_config.h"
 #include "options/m_property.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
@@ -41,6 +42,7 @@
 #include "input/input.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/cache_file.h"
 #include "misc/json.h"
 #include "osdep/subprocess.h"
 #include "osdep/timer.h"
@@ -83,6 +85,20 @@ static const char * const builtin_lua_scripts[][2] = {
     {0}
 };
 
+struct lua_opts {
+    char *bytecode_cache_dir;
+};
+
+#define OPT_BASE_STRUCT struct lua_opts
+const struct m_sub_options lua_conf = {
+    .opts = (const struct m_option[]) {
+        {"lua-bytecode-cache-dir", OPT_STRING(bytecode_cache_dir),
+            .flags = M_OPT_FILE},
+        {0}
+    },
+    .size = sizeof(struct lua_opts),
+};
+
 // Represents a loaded script. Each has its own Lua state.
 struct script_ctx {
     const char *name;
@@ -96,6 +112,7 @@ struct script_ctx {
     lua_Alloc lua_allocf;
     void *lua_alloc_ud;
     struct stats_ctx *stats;
+    char *cache_dir; // for compiled chunks, NULL if disabled
 };
 
 #if LUA_VERSION_NUM <= 501
@@ -229,14 +246,77 @@ static int check_error(lua_State *L, int err)
 
 static void add_functions(struct script_ctx *ctx);
 
+struct bytecode_writer {
+    void *ta_ctx;
+    bstr data;
+};
+
+static int write_bytecode(lua_State *L, const void *p, size_t size, void *ud)
+{
+    struct bytecode_writer *w = ud;
+    bstr_xappend(w->ta_ctx, &w->data, (bstr){(unsigned char *)p, size});
+    return 0;
+}
+
+// Like luaL_loadbuffer(), but use the bytecode cache if it's enabled. The
+// cache file is found by hashing key, and is used only if it was written with
+// the same stamp. If key is the source itself, the stamp can be empty.
+static int load_chunk(lua_State *L, const char *source, size_t len,
+                      const char *name, bstr key, const char *stamp)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    if (!ctx->cache_dir || !stamp)
+        return luaL_loadbuffer(L, source, len, name);
+
+    void *tmp = talloc_new(NULL);
+
+    char *header = talloc_asprintf(tmp, "mpv lua bytecode v1 %s\n%s\n",
+                                   LUA_RELEASE, stamp);
+    char *filename = mp_cache_file_path(tmp, ctx->cache_dir, key);
+
+    if (stat(filename, &(struct stat){0}) == 0) {
+        bstr data = stream_read_file(filename, tmp, ctx->mpctx->global,
+                                     100000000);
+        // The Lua loader verifies that the bytecode is for this Lua build.
+        if (bstr_eatstart0(&data, header)) {
+            if (luaL_loadbuffer(L, data.start, data.len, name) == 0) {
+                MP_DBG(ctx, "loaded %s from bytecode cache\n", name);
+                talloc_free(tmp);
+                return 0;
+            }
+            lua_pop(L, 1); // error message; overwrite the stale file
+        }
+    }
+
+    int r = luaL_loadbuffer(L, source, len, name);
+    if (r == 0) {
+        struct bytecode_writer w = {tmp};
+        bstr_xappend(tmp, &w.data, bstr0(header));
+        if (lua_dump(L, write_bytecode, &w) == 0 &&
+            mp_cache_file_write(filename, w.data))
+        {
+            MP_DBG(ctx, "wrote bytecode cache file %s\n", filename);
+        }
+    }
+
+    talloc_free(tmp);
+    return r;
+}
+
 static void load_file(lua_State *L, const char *fname)
 {
     struct script_ctx *ctx = get_ctx(L);
     MP_DBG(ctx, "loading file %s\n", fname);
+    // Stat before reading, so a concurrent change invalidates the cache entry.
+    char *stamp = mp_cache_file_stamp(NULL, fname);
     struct bstr s = stream_read_file(fname, ctx, ctx->mpctx->global, 100000000);
-    if (!s.start)
+    if (!s.start) {
+        talloc_free(stamp);
         luaL_error(L, "Could not read file.\n");
-    if (luaL_loadbuffer(L, s.start, s.len, fname))
+    }
+    int r = load_chunk(L, s.start, s.len, fname, bstr0(fname), stamp);
+    talloc_free(stamp);
+    if (r)
         lua_error(L);
     lua_call(L, 0, 1);
     talloc_free(s.start);
@@ -250,7 +330,7 @@ static int load_builtin(lua_State *L)
     for (int n = 0; builtin_lua_scripts[n][0]; n++) {
         if (strcmp(name, builtin_lua_scripts[n][0]) == 0) {
             const char *script = builtin_lua_scripts[n][1];
-            if (luaL_loadbuffer(L, script, strlen(script), dispname))
+            if (load_chunk(L, script, strlen(script), dispname, bstr0(script), ""))
                 lua_error(L);
             lua_call(L, 0, 1);
             return 1;
@@ -434,6 +514,13 @@ static int load_lua(struct mp_script_args *args)
 
     stats_register_thread_cputime(ctx->stats, "cpu");
 
+    struct lua_opts *opts =
+        mp_get_config_group(ctx, args->mpctx->global, &lua_conf);
+    if (opts->bytecode_cache_dir && opts->bytecode_cache_dir[0]) {
+        ctx->cache_dir = mp_get_user_path(ctx, args->mpctx->global,
+                                          opts->bytecode_cache_dir);
+    }
+
     if (LUA_VERSION_NUM != 501 && LUA_VERSION_NUM != 502) {
         MP_FATAL(ctx, "Only Lua 5.1 and 5.2 are supported.\n");
         goto error_out;
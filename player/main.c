@@ -164,6 +164,9 @@ void mp_destroy(struct MPContext *mpctx)
     mp_uninit_ipc(mpctx->ipc_ctx);
     mpctx->ipc_ctx = NULL;
 
+    mp_shared_state_uninit(mpctx->shared_state);
+    mpctx->shared_state = NULL;
+
     uninit_audio_out(mpctx);
     uninit_video_out(mpctx);
 
@@ -363,6 +366,8 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_get_resume_defaults(mpctx);
 
+    stats_phase(mpctx->global, "options");
+
     mp_input_load_config(mpctx->input);
 
     // From this point on, all mpctx members are initialized.
@@ -409,6 +414,8 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_load_scripts(mpctx);
 
+    stats_phase(mpctx->global, "scripts");
+
     if (opts->force_vo == 2 && handle_force_window(mpctx, false) < 0)
         return -1;
 
@@ -416,6 +423,7 @@ int mp_initialize(struct MPContext *mpctx, char **options)
     if (mpctx->opts->player_idle_mode && !mpctx->playlist->num_entries)
         mpctx->stop_play = PT_STOP;
 
+    stats_phase(mpctx->global, "init");
     MP_STATS(mpctx, "end init");
 
     return 0;
@@ -45,6 +45,8 @@
 #include "stream/stream.h"
 #include "sub/dec_sub.h"
 #include "sub/osd.h"
+#include "video/image_arena.h"
+#include "video/mp_image_pool.h"
 #include "video/out/vo.h"
 
 #include "core.h"
@@ -57,8 +59,11 @@
 void mp_wait_events(struct MPContext *mpctx)
 {
     mp_client_send_property_changes(mpctx);
+    mp_shared_state_update(mpctx);
 
     stats_event(mpctx->stats, "iterations");
+    mp_image_pool_report_stats(mpctx->stats);
+    mp_image_arena_report_stats(mpctx->stats);
 
     bool sleeping = mpctx->sleeptime > 0;
     if (sleeping)
@@ -1142,6 +1147,8 @@ static void handle_playback_restart(struct MPContext *mpctx)
             }
         }
         mpctx->playing_msg_shown = true;
+        stats_phases_end(mpctx->global, "playback-start", mpctx->log);
+        mp_notify_property(mpctx, "startup-phases");
         mp_wakeup_core(mpctx);
         update_ab_loop_clip(mpctx);
         MP_VERBOSE(mpctx, "playback restart complete @ %f, audio=%s, video=%s\n",
@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -31,6 +32,7 @@
 #include "misc/bstr.h"
 #include "misc/dispatch.h"
 #include "misc/node.h"
+#include "misc/thread_pool.h"
 #include "misc/thread_tools.h"
 #include "common/msg.h"
 #include "options/path.h"
@@ -46,16 +48,37 @@
 #define MODE_FULL_WINDOW 1
 #define MODE_SUBTITLES 2
 
+// Maximum number of sequence mode screenshots that can be waiting to be
+// written. If this is reached, the playloop blocks until one is done, instead
+// of piling up decoded images in memory forever.
+#define MAX_PENDING_SEQUENCE 8
+
 typedef struct screenshot_ctx {
     struct MPContext *mpctx;
 
-    // Command to repeat in each-frame mode.
-    struct mp_cmd *each_frame;
+    // Sequence mode (each-frame flag or screenshot-sequence command): take a
+    // screenshot every seq_interval-th displayed frame. 0 means disabled.
+    int seq_interval;
+    int seq_mode;
+    int seq_skipped;
+
+    // Number of screenshots currently being written on worker threads.
+    int pending;
 
     int frameno;
     uint64_t last_frame_count;
 } screenshot_ctx;
 
+// A captured screenshot, which is converted and written on a worker thread.
+struct write_job {
+    struct MPContext *mpctx;
+    struct mp_cmd_ctx *cmd;     // NULL for sequence mode screenshots
+    struct mp_image *image;
+    char *filename;
+    struct image_writer_opts opts;
+    bool ok;
+};
+
 void screenshot_init(struct MPContext *mpctx)
 {
     mpctx->screenshot_ctx = talloc(mpctx, screenshot_ctx);
@@ -73,28 +96,91 @@ static char *stripext(void *talloc_ctx, const char *s)
     return talloc_asprintf(talloc_ctx, "%.*s", (int)(end - s), s);
 }
 
-static bool write_screenshot(struct mp_cmd_ctx *cmd, struct mp_image *img,
-                             const char *filename, struct image_writer_opts *opts)
+// Like mp_cmd_msg(), but cmd can be NULL (then only log the message).
+PRINTF_ATTRIBUTE(4, 5)
+static void screenshot_msg(struct MPContext *mpctx, struct mp_cmd_ctx *cmd,
+                           int status, const char *msg, ...)
 {
-    struct MPContext *mpctx = cmd->mpctx;
-    struct image_writer_opts *gopts = mpctx->opts->screenshot_image_opts;
-    struct image_writer_opts opts_copy = opts ? *opts : *gopts;
+    va_list ap;
+    va_start(ap, msg);
+    char *s = talloc_vasprintf(NULL, msg, ap);
+    va_end(ap);
 
-    mp_cmd_msg(cmd, MSGL_V, "Starting screenshot: '%s'", filename);
-
-    mp_core_unlock(mpctx);
+    if (cmd) {
+        mp_cmd_msg(cmd, status, "%s", s);
+    } else {
+        MP_MSG(mpctx, status, "%s\n", s);
+    }
 
-    bool ok = img && write_image(img, &opts_copy, filename, mpctx->global,
-                                 mpctx->log);
+    talloc_free(s);
+}
 
-    mp_core_lock(mpctx);
+// Called on the core thread (dispatch queue) once the worker is done.
+static void write_job_done(void *p)
+{
+    struct write_job *job = p;
+    struct MPContext *mpctx = job->mpctx;
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
 
-    if (ok) {
-        mp_cmd_msg(cmd, MSGL_INFO, "Screenshot: '%s'", filename);
+    if (job->ok) {
+        screenshot_msg(mpctx, job->cmd, MSGL_INFO, "Screenshot: '%s'",
+                       job->filename);
     } else {
-        mp_cmd_msg(cmd, MSGL_ERR, "Error writing screenshot!");
+        screenshot_msg(mpctx, job->cmd, MSGL_ERR, "Error writing screenshot!");
+    }
+
+    if (job->cmd) {
+        job->cmd->success = job->ok;
+        mp_cmd_ctx_complete(job->cmd);
+    }
+
+    ctx->pending -= 1;
+    mpctx->outstanding_async -= 1;
+    talloc_free(job);
+
+    // For handle_each_frame_screenshot() and for shutdown.
+    mp_wakeup_core(mpctx);
+}
+
+static void write_job_run(void *p)
+{
+    struct write_job *job = p;
+    struct MPContext *mpctx = job->mpctx;
+
+    job->ok = write_image(job->image, &job->opts, job->filename, mpctx->global,
+                          mpctx->log);
+
+    mp_dispatch_enqueue(mpctx->dispatch, write_job_done, job);
+}
+
+// Convert and write the image on a worker thread. Takes ownership of img and
+// filename. If cmd is not NULL, the command is completed once the file was
+// written (the command must be marked as exec_async).
+static void write_screenshot(struct MPContext *mpctx, struct mp_cmd_ctx *cmd,
+                             struct mp_image *img, char *filename,
+                             struct image_writer_opts *opts)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+
+    screenshot_msg(mpctx, cmd, MSGL_V, "Starting screenshot: '%s'", filename);
+
+    struct write_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct write_job){
+        .mpctx = mpctx,
+        .cmd = cmd,
+        .image = talloc_steal(job, img),
+        .filename = talloc_steal(job, filename),
+        .opts = opts ? *opts : *mpctx->opts->screenshot_image_opts,
+    };
+
+    // Prevent that the core disappears while the job is running.
+    mpctx->outstanding_async += 1;
+    ctx->pending += 1;
+
+    if (!mp_thread_pool_queue(mpctx->thread_pool, write_job_run, job)) {
+        // Could not create any worker thread; write it on the core thread.
+        write_job_run(job);
     }
-    return ok;
 }
 
 #ifdef _WIN32
@@ -270,9 +356,9 @@ error_exit:
     return NULL;
 }
 
-static char *gen_fname(struct mp_cmd_ctx *cmd, const char *file_ext)
+static char *gen_fname(struct MPContext *mpctx, struct mp_cmd_ctx *cmd,
+                       const char *file_ext)
 {
-    struct MPContext *mpctx = cmd->mpctx;
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
 
     int sequence = 0;
@@ -285,9 +371,9 @@ static char *gen_fname(struct mp_cmd_ctx *cmd, const char *file_ext)
                                    &ctx->frameno);
 
         if (!fname) {
-            mp_cmd_msg(cmd, MSGL_ERR, "Invalid screenshot filename "
-                       "template! Fix or remove the --screenshot-template "
-                       "option.");
+            screenshot_msg(mpctx, cmd, MSGL_ERR, "Invalid screenshot filename "
+                           "template! Fix or remove the --screenshot-template "
+                           "option.");
             return NULL;
         }
 
@@ -311,8 +397,8 @@ static char *gen_fname(struct mp_cmd_ctx *cmd, const char *file_ext)
             return fname;
 
         if (sequence == prev_sequence) {
-            mp_cmd_msg(cmd, MSGL_ERR, "Can't save screenshot, file '%s' "
-                       "already exists!", fname);
+            screenshot_msg(mpctx, cmd, MSGL_ERR, "Can't save screenshot, file "
+                           "'%s' already exists!", fname);
             talloc_free(fname);
             return NULL;
         }
@@ -337,7 +423,7 @@ static struct mp_image *screenshot_get(struct MPContext *mpctx, int mode,
     bool need_add_subs = mode == MODE_SUBTITLES;
 
     if (mpctx->video_out && mpctx->video_out->config_ok) {
-        vo_wait_frame(mpctx->video_out); // important for each-frame mode
+        vo_wait_frame(mpctx->video_out); // important for sequence mode
 
         struct voctrl_screenshot ctrl = {
             .scaled = mode == MODE_FULL_WINDOW,
@@ -426,6 +512,42 @@ static struct mp_image *screenshot_get_rgb(struct MPContext *mpctx, int mode)
     return res;
 }
 
+// Capture a screenshot and start writing it with the --screenshot-* options.
+// Returns false if nothing could be captured or no filename could be created;
+// otherwise cmd (if not NULL) is completed by the write job.
+static bool take_screenshot(struct MPContext *mpctx, struct mp_cmd_ctx *cmd,
+                            int mode)
+{
+    struct image_writer_opts *opts = mpctx->opts->screenshot_image_opts;
+    bool high_depth = image_writer_high_depth(opts);
+
+    struct mp_image *image = screenshot_get(mpctx, mode, high_depth);
+    if (!image) {
+        screenshot_msg(mpctx, cmd, MSGL_ERR, "Taking screenshot failed.");
+        return false;
+    }
+
+    char *filename = gen_fname(mpctx, cmd, image_writer_file_ext(opts));
+    if (!filename) {
+        talloc_free(image);
+        return false;
+    }
+
+    write_screenshot(mpctx, cmd, image, filename, NULL);
+    return true;
+}
+
+static void set_sequence(struct MPContext *mpctx, int interval, int mode)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+
+    ctx->seq_interval = interval;
+    ctx->seq_mode = mode;
+    ctx->seq_skipped = 0;
+    // Start with the next displayed frame.
+    ctx->last_frame_count = mpctx->shown_vframes;
+}
+
 void cmd_screenshot_to_file(void *p)
 {
     struct mp_cmd_ctx *cmd = p;
@@ -443,10 +565,10 @@ void cmd_screenshot_to_file(void *p)
     if (!image) {
         mp_cmd_msg(cmd, MSGL_ERR, "Taking screenshot failed.");
         cmd->success = false;
+        mp_cmd_ctx_complete(cmd);
         return;
     }
-    cmd->success = write_screenshot(cmd, image, filename, &opts);
-    talloc_free(image);
+    write_screenshot(mpctx, cmd, image, talloc_strdup(NULL, filename), &opts);
 }
 
 void cmd_screenshot(void *p)
@@ -455,43 +577,47 @@ void cmd_screenshot(void *p)
     struct MPContext *mpctx = cmd->mpctx;
     int mode = cmd->args[0].v.i & 3;
     bool each_frame_toggle = (cmd->args[0].v.i | cmd->args[1].v.i) & 8;
-    bool each_frame_mode = cmd->args[0].v.i & 16;
 
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
 
     if (mode == MODE_SUBTITLES && osd_get_render_subs_in_filter(mpctx->osd))
         mode = 0;
 
-    if (!each_frame_mode) {
-        if (each_frame_toggle) {
-            if (ctx->each_frame) {
-                TA_FREEP(&ctx->each_frame);
-                return;
-            }
-            ctx->each_frame = talloc_steal(ctx, mp_cmd_clone(cmd->cmd));
-            ctx->each_frame->args[0].v.i |= 16;
-        } else {
-            TA_FREEP(&ctx->each_frame);
+    if (each_frame_toggle) {
+        if (ctx->seq_interval) {
+            set_sequence(mpctx, 0, 0);
+            mp_cmd_ctx_complete(cmd);
+            return;
         }
+        set_sequence(mpctx, 1, mode);
+    } else {
+        set_sequence(mpctx, 0, 0);
     }
 
-    cmd->success = false;
+    if (!take_screenshot(mpctx, cmd, mode)) {
+        cmd->success = false;
+        mp_cmd_ctx_complete(cmd);
+    }
+}
 
-    struct image_writer_opts *opts = mpctx->opts->screenshot_image_opts;
-    bool high_depth = image_writer_high_depth(opts);
+void cmd_screenshot_sequence(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+    int interval = cmd->args[0].v.i;
+    int mode = cmd->args[1].v.i;
 
-    struct mp_image *image = screenshot_get(mpctx, mode, high_depth);
+    if (mode == MODE_SUBTITLES && osd_get_render_subs_in_filter(mpctx->osd))
+        mode = 0;
 
-    if (image) {
-        char *filename = gen_fname(cmd, image_writer_file_ext(opts));
-        if (filename)
-            cmd->success = write_screenshot(cmd, image, filename, NULL);
-        talloc_free(filename);
+    set_sequence(mpctx, interval, mode);
+
+    if (interval) {
+        mp_cmd_msg(cmd, MSGL_INFO, "Taking a screenshot every %d frame(s).",
+                   interval);
     } else {
-        mp_cmd_msg(cmd, MSGL_ERR, "Taking screenshot failed.");
+        mp_cmd_msg(cmd, MSGL_INFO, "Screenshot sequence stopped.");
     }
-
-    talloc_free(image);
 }
 
 void cmd_screenshot_raw(void *p)
@@ -520,35 +646,28 @@ void cmd_screenshot_raw(void *p)
     talloc_steal(ba, img);
 }
 
-static void screenshot_fin(struct mp_cmd_ctx *cmd)
-{
-    void **a = cmd->on_completion_priv;
-    struct MPContext *mpctx = a[0];
-    struct mp_waiter *waiter = a[1];
-
-    mp_waiter_wakeup(waiter, 0);
-    mp_wakeup_core(mpctx);
-}
-
 void handle_each_frame_screenshot(struct MPContext *mpctx)
 {
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
 
-    if (!ctx->each_frame)
+    if (!ctx->seq_interval)
         return;
 
     if (ctx->last_frame_count == mpctx->shown_vframes)
         return;
     ctx->last_frame_count = mpctx->shown_vframes;
 
-    struct mp_waiter wait = MP_WAITER_INITIALIZER;
-    void *a[] = {mpctx, &wait};
-    run_command(mpctx, mp_cmd_clone(ctx->each_frame), NULL, screenshot_fin, a);
+    ctx->seq_skipped += 1;
+    if (ctx->seq_skipped < ctx->seq_interval)
+        return;
+    ctx->seq_skipped = 0;
 
-    // Block (in a reentrant way) until the screenshot was written. Otherwise,
-    // we could pile up screenshot requests forever.
-    while (!mp_waiter_poll(&wait))
+    // Block (in a reentrant way) only if too many screenshots are still being
+    // written. Otherwise, we could pile up screenshot requests forever.
+    while (ctx->pending >= MAX_PENDING_SEQUENCE)
         mp_idle(mpctx);
 
-    mp_waiter_wait(&wait);
+    // The sequence could have been stopped by a command run from mp_idle().
+    if (ctx->seq_interval)
+        take_screenshot(mpctx, NULL, ctx->seq_mode);
 }
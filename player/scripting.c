@@ -37,8 +37,10 @@
 #include "options/parse_configfile.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "stream/stream.h"
 #include "core.h"
 #include "client.h"
+#include "command.h"
 #include "libmpv/client.h"
 
 extern const struct mp_scripting mp_scripting_lua;
@@ -81,6 +83,15 @@ static char *script_name_from_filename(void *talloc_ctx, const char *fname)
     return talloc_asprintf(talloc_ctx, "%s", name);
 }
 
+// Client name of a script directory. Lazily loaded scripts must get the same
+// name, since they are addressed by it before they are loaded.
+static char *script_name_from_dir(void *talloc_ctx, const char *path)
+{
+    char *name = talloc_strdup(talloc_ctx, path);
+    mp_path_strip_trailing_separator(name);
+    return mp_basename(name);
+}
+
 static void run_script(struct mp_script_args *arg)
 {
     char name[90];
@@ -141,9 +152,7 @@ static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
             return -1;
         }
 
-        script_name = talloc_strdup(tmp, path);
-        mp_path_strip_trailing_separator(script_name);
-        script_name = mp_basename(script_name);
+        script_name = script_name_from_dir(tmp, path);
     } else {
         for (int n = 0; scripting_backends[n]; n++) {
             const struct mp_scripting *b = scripting_backends[n];
@@ -239,16 +248,235 @@ static char **list_script_files(void *talloc_ctx, char *path)
     return files;
 }
 
+struct lazy_trigger {
+    int type;               // MP_LAZY_BINDING/MESSAGE/PROPERTY
+    char *name;
+    int prop_id;            // for MP_LAZY_PROPERTY
+};
+
+// A script which was not started yet, and which is started by the first
+// matching mp_trigger_lazy_scripts() call.
+struct lazy_script {
+    char *name;             // client name the script will get
+    char *filename;
+    int builtin_slot;       // index into builtin_script_ids[], or -1
+    struct lazy_trigger *triggers;
+    int num_triggers;
+    uint64_t event_mask;    // events which change MP_LAZY_PROPERTY triggers
+};
+
+static struct lazy_script *add_lazy_script(struct MPContext *mpctx,
+                                           const char *fname, const char *name,
+                                           int builtin_slot)
+{
+    struct lazy_script *ls = talloc_ptrtype(mpctx, ls);
+    *ls = (struct lazy_script){
+        .name = talloc_strdup(ls, name),
+        .filename = talloc_strdup(ls, fname),
+        .builtin_slot = builtin_slot,
+    };
+    MP_TARRAY_APPEND(mpctx, mpctx->lazy_scripts, mpctx->num_lazy_scripts, ls);
+    MP_DBG(mpctx, "Script '%s' will be loaded on first use.\n", name);
+    return ls;
+}
+
+static int find_lazy_builtin_script(struct MPContext *mpctx, int slot)
+{
+    for (int n = 0; n < mpctx->num_lazy_scripts; n++) {
+        if (mpctx->lazy_scripts[n]->builtin_slot == slot)
+            return n;
+    }
+    return -1;
+}
+
+static void start_lazy_script(struct MPContext *mpctx, int index)
+{
+    struct lazy_script *ls = mpctx->lazy_scripts[index];
+    MP_TARRAY_REMOVE_AT(mpctx->lazy_scripts, mpctx->num_lazy_scripts, index);
+    MP_VERBOSE(mpctx, "Loading script '%s' on first use.\n", ls->name);
+    int64_t id = mp_load_script(mpctx, ls->filename);
+    if (ls->builtin_slot >= 0)
+        mpctx->builtin_script_ids[ls->builtin_slot] = id;
+    talloc_free(ls);
+}
+
+// Start all lazily loaded scripts which have a trigger matching the given
+// type and name. MP_LAZY_CLIENT matches any script by its client name.
+// Since the script's client is created synchronously, the caller can send
+// messages to it right after this returns; the script sees them once it
+// has finished loading.
+void mp_trigger_lazy_scripts(struct MPContext *mpctx, int type, const char *name)
+{
+    if (!mpctx->num_lazy_scripts || !name)
+        return;
+
+    int prop_id = -1;
+    if (type == MP_LAZY_PROPERTY) {
+        prop_id = mp_get_property_id(mpctx, name);
+        if (prop_id < 0)
+            return;
+    }
+
+    for (int n = mpctx->num_lazy_scripts - 1; n >= 0; n--) {
+        struct lazy_script *ls = mpctx->lazy_scripts[n];
+        bool match = type == MP_LAZY_CLIENT && strcmp(ls->name, name) == 0;
+        for (int i = 0; i < ls->num_triggers && !match; i++) {
+            struct lazy_trigger *t = &ls->triggers[i];
+            if (t->type != type)
+                continue;
+            match = type == MP_LAZY_PROPERTY ? t->prop_id == prop_id
+                                             : strcmp(t->name, name) == 0;
+        }
+        if (match)
+            start_lazy_script(mpctx, n);
+    }
+}
+
+// Like mp_trigger_lazy_scripts(), for property triggers changed by events.
+void mp_trigger_lazy_scripts_event(struct MPContext *mpctx, int event)
+{
+    if (!mpctx->num_lazy_scripts)
+        return;
+
+    uint64_t mask = 1ULL << event;
+    for (int n = mpctx->num_lazy_scripts - 1; n >= 0; n--) {
+        if (mpctx->lazy_scripts[n]->event_mask & mask)
+            start_lazy_script(mpctx, n);
+    }
+}
+
+// Parse the manifest of a script directory. Each line declares a trigger:
+//  binding <key> <name>    bind key to "script-binding <script>/<name>"
+//  message <name>          broadcast "script-message <name> ..."
+//  property <name>         change of the named property
+static bool parse_manifest(struct MPContext *mpctx, struct lazy_script *ls,
+                           bstr data, const char *fname)
+{
+    char *bindings = talloc_strdup(ls, "");
+    int lineno = 0;
+    while (data.len) {
+        bstr line = bstr_strip(bstr_getline(data, &data));
+        lineno++;
+        if (!line.len || bstr_startswith0(line, "#"))
+            continue;
+
+        bstr type, name, key = {0};
+        if (!bstr_split_tok(line, " ", &type, &name))
+            goto error;
+        name = bstr_strip(name);
+        struct lazy_trigger t = {.prop_id = -1};
+        if (bstr_equals0(type, "binding")) {
+            t.type = MP_LAZY_BINDING;
+            if (!bstr_split_tok(name, " ", &key, &name))
+                goto error;
+            name = bstr_strip(name);
+            bindings = talloc_asprintf_append(bindings,
+                            "%.*s script-binding %s/%.*s\n", BSTR_P(key),
+                            ls->name, BSTR_P(name));
+        } else if (bstr_equals0(type, "message")) {
+            t.type = MP_LAZY_MESSAGE;
+        } else if (bstr_equals0(type, "property")) {
+            t.type = MP_LAZY_PROPERTY;
+        } else {
+            goto error;
+        }
+        t.name = bstrto0(ls, name);
+        if (t.type == MP_LAZY_PROPERTY) {
+            t.prop_id = mp_get_property_id(mpctx, t.name);
+            if (t.prop_id < 0) {
+                MP_WARN(mpctx, "%s:%d: unknown property '%s'\n", fname,
+                        lineno, t.name);
+                continue;
+            }
+            // Ignore events which change all properties (like file loading),
+            // or nearly every property trigger would fire at startup.
+            ls->event_mask |= mp_get_property_event_mask(t.name) &
+                              ~mp_get_property_event_mask("*");
+        }
+        MP_TARRAY_APPEND(ls, ls->triggers, ls->num_triggers, t);
+        continue;
+    error:
+        MP_ERR(mpctx, "%s:%d: invalid line '%.*s'\n", fname, lineno,
+               BSTR_P(line));
+        return false;
+    }
+
+    // Placeholder for the script's own default bindings, which replace it
+    // when the script defines them.
+    if (bindings[0]) {
+        char *section = talloc_asprintf(ls, "input_%s", ls->name);
+        mp_input_define_section(mpctx->input, section, (char *)fname, bindings,
+                                true, ls->name);
+        mp_input_enable_section(mpctx->input, section,
+                                MP_INPUT_ALLOW_HIDE_CURSOR |
+                                MP_INPUT_ALLOW_VO_DRAGGING);
+    }
+    return true;
+}
+
+// If fname is a script directory with a manifest file, register it as lazy
+// script and return true. Otherwise, the script must be loaded normally.
+static bool add_lazy_user_script(struct MPContext *mpctx, const char *fname)
+{
+    if (!mpctx->opts->lazy_load_scripts)
+        return false;
+
+    void *tmp = talloc_new(NULL);
+    char *manifest = mp_path_join(tmp, fname, "manifest");
+    struct stat s;
+    if (stat(manifest, &s) || !S_ISREG(s.st_mode)) {
+        talloc_free(tmp);
+        return false;
+    }
+
+    char *name = script_name_from_dir(tmp, fname);
+
+    bool ok = false;
+    bstr data = stream_read_file(manifest, tmp, mpctx->global, 1000000);
+    if (data.start) {
+        struct lazy_script *ls = add_lazy_script(mpctx, fname, name, -1);
+        ok = parse_manifest(mpctx, ls, data, manifest);
+        if (!ok) {
+            // Load it normally instead.
+            MP_TARRAY_REMOVE_AT(mpctx->lazy_scripts, mpctx->num_lazy_scripts,
+                                mpctx->num_lazy_scripts - 1);
+            talloc_free(ls);
+        }
+    }
+    talloc_free(tmp);
+    return ok;
+}
+
+static int64_t load_script_or_lazy(struct MPContext *mpctx, const char *fname)
+{
+    if (add_lazy_user_script(mpctx, fname))
+        return 0;
+    return mp_load_script(mpctx, fname);
+}
+
+// lazy: the script only needs to run once it is addressed by name (such as
+// "script-binding stats/display-stats" from the default input.conf)
 static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
-                                const char *fname)
+                                const char *fname, bool lazy)
 {
     assert(slot < MP_ARRAY_SIZE(mpctx->builtin_script_ids));
     int64_t *pid = &mpctx->builtin_script_ids[slot];
     if (*pid > 0 && !mp_client_id_exists(mpctx, *pid))
         *pid = 0; // died
-    if ((*pid > 0) != enable) {
+    int lazy_index = find_lazy_builtin_script(mpctx, slot);
+    if ((*pid > 0 || lazy_index >= 0) != enable) {
         if (enable) {
-            *pid = mp_load_script(mpctx, fname);
+            if (lazy && mpctx->opts->lazy_load_scripts) {
+                char *name = script_name_from_filename(NULL, fname);
+                add_lazy_script(mpctx, fname, name, slot);
+                talloc_free(name);
+            } else {
+                *pid = mp_load_script(mpctx, fname);
+            }
+        } else if (lazy_index >= 0) {
+            talloc_free(mpctx->lazy_scripts[lazy_index]);
+            MP_TARRAY_REMOVE_AT(mpctx->lazy_scripts, mpctx->num_lazy_scripts,
+                                lazy_index);
         } else {
             char *name = mp_tprintf(22, "@%"PRIi64, *pid);
             mp_client_send_event(mpctx, name, 0, MPV_EVENT_SHUTDOWN, NULL);
@@ -258,12 +486,14 @@ static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
 
 void mp_load_builtin_scripts(struct MPContext *mpctx)
 {
-    load_builtin_script(mpctx, 0, mpctx->opts->lua_load_osc, "@osc.lua");
-    load_builtin_script(mpctx, 1, mpctx->opts->lua_load_ytdl, "@ytdl_hook.lua");
-    load_builtin_script(mpctx, 2, mpctx->opts->lua_load_stats, "@stats.lua");
-    load_builtin_script(mpctx, 3, mpctx->opts->lua_load_console, "@console.lua");
-    load_builtin_script(mpctx, 4, mpctx->opts->lua_load_auto_profiles,
-                        "@auto_profiles.lua");
+    struct MPOpts *opts = mpctx->opts;
+    load_builtin_script(mpctx, 0, opts->lua_load_osc, "@osc.lua", false);
+    load_builtin_script(mpctx, 1, opts->lua_load_ytdl, "@ytdl_hook.lua", false);
+    load_builtin_script(mpctx, 2, opts->lua_load_stats, "@stats.lua", true);
+    // Not lazy: the console shows the log messages since it was started.
+    load_builtin_script(mpctx, 3, opts->lua_load_console, "@console.lua", false);
+    load_builtin_script(mpctx, 4, opts->lua_load_auto_profiles,
+                        "@auto_profiles.lua", false);
 }
 
 bool mp_load_scripts(struct MPContext *mpctx)
@@ -273,8 +503,11 @@ bool mp_load_scripts(struct MPContext *mpctx)
     // Load scripts from options
     char **files = mpctx->opts->script_files;
     for (int n = 0; files && files[n]; n++) {
-        if (files[n][0])
-            ok &= mp_load_user_script(mpctx, files[n]) >= 0;
+        if (files[n][0]) {
+            char *path = mp_get_user_path(NULL, mpctx->global, files[n]);
+            ok &= load_script_or_lazy(mpctx, path) >= 0;
+            talloc_free(path);
+        }
     }
     if (!mpctx->opts->auto_load_scripts)
         return ok;
@@ -285,7 +518,7 @@ bool mp_load_scripts(struct MPContext *mpctx)
     for (int i = 0; scriptsdir && scriptsdir[i]; i++) {
         files = list_script_files(tmp, scriptsdir[i]);
         for (int n = 0; files && files[n]; n++)
-            ok &= mp_load_script(mpctx, files[n]) >= 0;
+            ok &= load_script_or_lazy(mpctx, files[n]) >= 0;
     }
     talloc_free(tmp);
 
@@ -0,0 +1,228 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "config.h"
+
+#define HAVE_SHARED_STATE (HAVE_POSIX && HAVE_STDATOMIC)
+
+#if HAVE_SHARED_STATE
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "common/playlist.h"
+#include "demux/demux.h"
+#include "filters/f_decoder_wrapper.h"
+#include "options/options.h"
+#include "options/path.h"
+#include "osdep/atomic.h"
+#include "osdep/io.h"
+#include "video/out/vo.h"
+
+#include "core.h"
+#include "shared_state.h"
+
+struct mp_shared_state_ctx {
+    struct mp_log *log;
+    int fd;
+    struct mp_shared_state *state;
+};
+
+#if HAVE_SHARED_STATE
+
+struct mp_shared_state_ctx *mp_shared_state_init(struct MPContext *mpctx)
+{
+    char *opt = mpctx->opts->shared_state_path;
+    if (!opt || !opt[0])
+        return NULL;
+
+    struct mp_shared_state_ctx *ctx = talloc_zero(NULL, struct mp_shared_state_ctx);
+    ctx->log = mp_log_new(ctx, mpctx->log, "shared-state");
+    ctx->fd = -1;
+
+    char *path = mp_get_user_path(ctx, mpctx->global, opt);
+    ctx->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (ctx->fd < 0 || ftruncate(ctx->fd, sizeof(*ctx->state)) < 0) {
+        MP_ERR(ctx, "Could not create '%s': %s\n", path, mp_strerror(errno));
+        goto error;
+    }
+
+    void *p = mmap(NULL, sizeof(*ctx->state), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, ctx->fd, 0);
+    if (p == MAP_FAILED) {
+        MP_ERR(ctx, "Could not map '%s': %s\n", path, mp_strerror(errno));
+        goto error;
+    }
+    ctx->state = p;
+
+    // Readers must not see a half-initialized header, so invalidate the magic
+    // first. (They can still see the state of a previous writer.)
+    ctx->state->magic = 0;
+    atomic_thread_fence(memory_order_seq_cst);
+    ctx->state->version = MP_SHARED_STATE_VERSION;
+    ctx->state->size = sizeof(*ctx->state);
+    ctx->state->pid = getpid();
+    atomic_thread_fence(memory_order_seq_cst);
+    ctx->state->magic = MP_SHARED_STATE_MAGIC;
+
+    MP_VERBOSE(ctx, "Publishing playback state to '%s'.\n", path);
+    return ctx;
+
+error:
+    mp_shared_state_uninit(ctx);
+    return NULL;
+}
+
+// Start and end an update. The seq field is accessed atomically, but it's
+// declared as plain integer to keep the layout header free of dependencies.
+static uint64_t write_begin(struct mp_shared_state *s)
+{
+    mp_atomic_uint64 *seq = (mp_atomic_uint64 *)&s->seq;
+    uint64_t v = atomic_load_explicit(seq, memory_order_relaxed);
+    if (v & 1)
+        v++; // previous writer crashed during an update
+    atomic_store_explicit(seq, v + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return v + 2;
+}
+
+static void write_end(struct mp_shared_state *s, uint64_t v)
+{
+    mp_atomic_uint64 *seq = (mp_atomic_uint64 *)&s->seq;
+    atomic_store_explicit(seq, v, memory_order_release);
+}
+
+void mp_shared_state_uninit(struct mp_shared_state_ctx *ctx)
+{
+    if (!ctx)
+        return;
+
+    if (ctx->state) {
+        uint64_t seq = write_begin(ctx->state);
+        ctx->state->active = 0;
+        write_end(ctx->state, seq);
+        munmap(ctx->state, sizeof(*ctx->state));
+    }
+    if (ctx->fd >= 0)
+        close(ctx->fd);
+    talloc_free(ctx);
+}
+
+static double monotonic_time(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts))
+        return 0;
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double or_nan(double v, bool valid)
+{
+    return valid ? v : NAN;
+}
+
+// Publish the current state. Called once per playloop iteration. This uses
+// the same sources as the corresponding properties in command.c.
+void mp_shared_state_update(struct MPContext *mpctx)
+{
+    struct mp_shared_state_ctx *ctx = mpctx->shared_state;
+    if (!ctx)
+        return;
+
+    // Gather everything first, to keep the time readers have to retry short.
+    struct mp_shared_state n = {
+        .monotonic_time = monotonic_time(),
+        .active = 1,
+        .playback_active = mpctx->playback_initialized,
+        .pause = mpctx->opts->pause,
+        .core_idle = !mpctx->playback_active,
+        .idle_active = mpctx->stop_play == PT_STOP,
+        .paused_for_cache = mpctx->paused_for_cache,
+        .eof_reached = mpctx->video_status == STATUS_EOF &&
+                       mpctx->audio_status == STATUS_EOF,
+        .seeking = !mpctx->restart_complete,
+        .playlist_pos = playlist_entry_to_index(mpctx->playlist,
+                                                mpctx->playlist->current),
+        .time_pos = NAN,
+        .duration = NAN,
+        .percent_pos = NAN,
+        .speed = mpctx->opts->playback_speed,
+        .cache_duration = NAN,
+        .cache_bytes = -1,
+        .frame_drop_count = -1,
+        .decoder_frame_drop_count = -1,
+    };
+
+    if (mpctx->playback_initialized) {
+        double time_pos = get_current_time(mpctx);
+        n.time_pos = or_nan(time_pos, time_pos != MP_NOPTS_VALUE);
+        double len = get_time_length(mpctx);
+        n.duration = or_nan(len, len >= 0);
+        double pos = get_current_pos_ratio(mpctx, false) * 100.0;
+        n.percent_pos = or_nan(pos, pos >= 0);
+    }
+
+    if (mpctx->demuxer) {
+        struct demux_reader_state s;
+        demux_get_reader_state(mpctx->demuxer, &s);
+        n.cache_duration = or_nan(s.ts_duration, s.ts_duration >= 0);
+        n.cache_bytes = s.fw_bytes;
+    }
+
+    if (mpctx->vo_chain) {
+        n.frame_drop_count = vo_get_drop_count(mpctx->video_out);
+        struct mp_decoder_wrapper *dec =
+            mpctx->vo_chain->track ? mpctx->vo_chain->track->dec : NULL;
+        if (dec)
+            n.decoder_frame_drop_count = mp_decoder_wrapper_get_frames_dropped(dec);
+    }
+
+    struct mp_shared_state *s = ctx->state;
+    const size_t start = offsetof(struct mp_shared_state, monotonic_time);
+    uint64_t seq = write_begin(s);
+    memcpy((char *)s + start, (char *)&n + start, sizeof(n) - start);
+    write_end(s, seq);
+}
+
+#else /* HAVE_SHARED_STATE */
+
+struct mp_shared_state_ctx *mp_shared_state_init(struct MPContext *mpctx)
+{
+    char *opt = mpctx->opts->shared_state_path;
+    if (opt && opt[0])
+        MP_ERR(mpctx, "--shared-state-file is not supported on this platform.\n");
+    return NULL;
+}
+
+void mp_shared_state_uninit(struct mp_shared_state_ctx *ctx)
+{
+}
+
+void mp_shared_state_update(struct MPContext *mpctx)
+{
+}
+
+#endif /* else HAVE_SHARED_STATE */
@@ -0,0 +1,67 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_SHARED_STATE_H_
+#define MP_SHARED_STATE_H_
+
+#include <stdint.h>
+
+// Layout of the file written with --shared-state-file. This header has no
+// dependencies, so external readers can copy it.
+//
+// Reading works like a seqlock: read seq, and retry if it's odd (an update is
+// in progress). Copy the fields, then read seq again (after a read barrier),
+// and retry if it changed.
+//
+// Compatible changes append fields and increase size. Incompatible changes
+// increase version.
+
+#define MP_SHARED_STATE_MAGIC 0x5376706d // "mpvS" in little endian
+#define MP_SHARED_STATE_VERSION 1
+
+struct mp_shared_state {
+    // -- written once
+    uint32_t magic;             // MP_SHARED_STATE_MAGIC
+    uint32_t version;           // MP_SHARED_STATE_VERSION
+    uint32_t size;              // sizeof(struct mp_shared_state) of the writer
+    uint32_t pid;               // process ID of the player
+
+    // -- seqlock; incremented before and after each update
+    uint64_t seq;
+
+    // -- protected by seq
+    double monotonic_time;      // CLOCK_MONOTONIC time of the update (seconds)
+    int32_t active;             // 0 if the player has stopped updating
+    int32_t playback_active;    // a file is loaded (the fields below are valid)
+    int32_t pause;              // "pause"
+    int32_t core_idle;          // "core-idle"
+    int32_t idle_active;        // "idle-active"
+    int32_t paused_for_cache;   // "paused-for-cache"
+    int32_t eof_reached;        // "eof-reached"
+    int32_t seeking;            // "seeking"
+    int64_t playlist_pos;       // "playlist-pos" (-1 if none)
+    double time_pos;            // "time-pos" (NAN if unavailable)
+    double duration;            // "duration" (NAN if unavailable)
+    double percent_pos;         // "percent-pos" (NAN if unavailable)
+    double speed;               // "speed"
+    double cache_duration;      // "demuxer-cache-duration" (NAN if unavailable)
+    int64_t cache_bytes;        // "demuxer-cache-state/fw-bytes" (-1 if none)
+    int64_t frame_drop_count;   // "frame-drop-count" (-1 if unavailable)
+    int64_t decoder_frame_drop_count; // "decoder-frame-drop-count" (-1 if n/a)
+};
+
+#endif
@@ -30,6 +30,7 @@
 #include "options/m_option.h"
 #include "common/common.h"
 #include "common/encode.h"
+#include "common/stats.h"
 #include "options/m_property.h"
 #include "osdep/timer.h"
 
@@ -238,6 +239,7 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             goto err_out;
         }
         mpctx->mouse_cursor_visible = true;
+        stats_phase(mpctx->global, "vo-init");
     }
 
     update_window_title(mpctx, true);
@@ -1214,6 +1216,8 @@ void write_video(struct MPContext *mpctx)
             vo_wait_frame(vo);
             MP_VERBOSE(mpctx, "first video frame after restart shown\n");
         }
+        if (mpctx->shown_vframes == 1)
+            stats_phase(mpctx->global, "first-frame");
     }
 
     mp_notify(mpctx, MPV_EVENT_TICK, NULL);
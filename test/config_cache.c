@@ -0,0 +1,156 @@
+#include <pthread.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_config_core.h"
+#include "options/m_option.h"
+#include "osdep/atomic.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+#define ROUNDS 20000
+#define MAX_WRITERS 4
+
+struct writer {
+    struct m_config_cache *cache;
+    int opt;
+    atomic_bool *stop;
+};
+
+// Create an option group with num_opts int options.
+static struct m_sub_options *make_group(void *ta_parent, int num_opts)
+{
+    struct m_option *opts = talloc_zero_array(ta_parent, struct m_option,
+                                              num_opts + 1);
+    for (int n = 0; n < num_opts; n++) {
+        opts[n] = (struct m_option){
+            .name = talloc_asprintf(ta_parent, "opt%d", n),
+            .type = &m_option_type_int,
+            .offset = n * sizeof(int),
+        };
+    }
+    struct m_sub_options *group = talloc_ptrtype(ta_parent, group);
+    *group = (struct m_sub_options){
+        .opts = opts,
+        .size = num_opts * sizeof(int),
+    };
+    return group;
+}
+
+static void write_int(struct m_config_cache *cache, int opt, int val)
+{
+    int *opts = cache->opts;
+    opts[opt] = val;
+    m_config_cache_write_opt(cache, &opts[opt]);
+}
+
+static void *writer_thread(void *p)
+{
+    struct writer *w = p;
+    for (int n = 0; !atomic_load(w->stop); n++)
+        write_int(w->cache, w->opt, n);
+    return NULL;
+}
+
+static void check_changes(struct test_ctx *ctx)
+{
+    void *tmp = talloc_new(NULL);
+    struct m_sub_options *group = make_group(tmp, 64);
+    struct m_config_shadow *shadow = m_config_shadow_new(group);
+    struct m_config_cache *reader = m_config_cache_from_shadow(tmp, shadow, group);
+    struct m_config_cache *writer = m_config_cache_from_shadow(tmp, shadow, group);
+    int *opts = reader->opts;
+    void *ptr;
+
+    assert_false(m_config_cache_update(reader));
+
+    write_int(writer, 10, 1);
+    write_int(writer, 50, 2);
+    assert_true(m_config_cache_get_next_changed(reader, &ptr));
+    assert_true(ptr == &opts[10]);
+    // Written while the reader is halfway through the group.
+    write_int(writer, 5, 3);
+    int changed = 0;
+    while (m_config_cache_get_next_changed(reader, &ptr)) {
+        assert_true(ptr == &opts[5] || ptr == &opts[50]);
+        changed++;
+    }
+    assert_int_equal(changed, 2);
+    assert_int_equal(opts[5] + opts[10] + opts[50], 6);
+
+    // Changed and reverted before the reader looked: no change.
+    write_int(writer, 20, 4);
+    write_int(writer, 20, 0);
+    assert_false(m_config_cache_update(reader));
+
+    talloc_free(reader);
+    talloc_free(writer);
+    talloc_free(shadow);
+    talloc_free(tmp);
+}
+
+// Time m_config_cache_update() on a group with num_opts options, while
+// num_writers threads change one option each.
+static void bench(struct test_ctx *ctx, int num_opts, int num_writers)
+{
+    void *tmp = talloc_new(NULL);
+    struct m_sub_options *group = make_group(tmp, num_opts);
+    struct m_config_shadow *shadow = m_config_shadow_new(group);
+    struct m_config_cache *reader = m_config_cache_from_shadow(tmp, shadow, group);
+    struct m_config_cache *writer = m_config_cache_from_shadow(tmp, shadow, group);
+
+    atomic_bool stop = ATOMIC_VAR_INIT(false);
+    struct writer writers[MAX_WRITERS];
+    pthread_t threads[MAX_WRITERS];
+    for (int n = 0; n < num_writers; n++) {
+        writers[n] = (struct writer){
+            .cache = m_config_cache_from_shadow(tmp, shadow, group),
+            .opt = num_opts - 1 - n,
+            .stop = &stop,
+        };
+        assert_true(pthread_create(&threads[n], NULL, writer_thread,
+                                   &writers[n]) == 0);
+    }
+
+    int64_t total = 0;
+    int updates = 0;
+    for (int n = 0; n < ROUNDS; n++) {
+        // Single option change between updates, like a script setting an
+        // option repeatedly.
+        write_int(writer, n % (num_opts - num_writers), n + 1);
+        int64_t t0 = mp_time_us();
+        updates += m_config_cache_update(reader);
+        total += mp_time_us() - t0;
+    }
+
+    atomic_store(&stop, true);
+    for (int n = 0; n < num_writers; n++) {
+        pthread_join(threads[n], NULL);
+        talloc_free(writers[n].cache);
+    }
+
+    assert_int_equal(updates, ROUNDS);
+
+    MP_INFO(ctx, "%5d options, %d writers: %6.3f us per update\n",
+            num_opts, num_writers, total / (double)ROUNDS);
+
+    talloc_free(reader);
+    talloc_free(writer);
+    talloc_free(shadow);
+    talloc_free(tmp);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    check_changes(ctx);
+
+    for (int n = 16; n <= 4096; n *= 4)
+        bench(ctx, n, 0);
+    for (int n = 1; n <= MAX_WRITERS; n *= 2)
+        bench(ctx, 256, n);
+}
+
+const struct unittest test_config_cache = {
+    .name = "config_cache",
+    .run = run,
+};
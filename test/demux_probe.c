@@ -0,0 +1,113 @@
+#include "common/common.h"
+#include "demux/demux.h"
+#include "osdep/timer.h"
+#include "stream/stream.h"
+#include "tests.h"
+
+#define ROUNDS 10
+
+struct sample {
+    const char *name;
+    bstr data;
+    const char *filetype;   // expected detected format, or NULL to not check
+};
+
+static void put_le(uint8_t *dst, uint32_t val, int bytes)
+{
+    for (int n = 0; n < bytes; n++)
+        dst[n] = val >> (n * 8);
+}
+
+// Deterministic data which isn't recognized as anything.
+static bstr make_noise(void *ta_parent, int size)
+{
+    uint8_t *data = talloc_size(ta_parent, size);
+    uint32_t state = 1;
+    for (int n = 0; n < size; n++) {
+        state = state * 1103515245 + 12345;
+        data[n] = state >> 16;
+    }
+    return (bstr){data, size};
+}
+
+// Silent mono 16 bit PCM.
+static bstr make_wav(void *ta_parent, int samples)
+{
+    int size = 44 + samples * 2;
+    uint8_t *data = talloc_zero_size(ta_parent, size);
+    memcpy(data, "RIFF", 4);
+    put_le(data + 4, size - 8, 4);
+    memcpy(data + 8, "WAVEfmt ", 8);
+    put_le(data + 16, 16, 4);       // fmt chunk size
+    put_le(data + 20, 1, 2);        // PCM
+    put_le(data + 22, 1, 2);        // channels
+    put_le(data + 24, 48000, 4);    // sample rate
+    put_le(data + 28, 48000 * 2, 4);// byte rate
+    put_le(data + 32, 2, 2);        // block align
+    put_le(data + 34, 16, 2);       // bits per sample
+    memcpy(data + 36, "data", 4);
+    put_le(data + 40, samples * 2, 4);
+    return (bstr){data, size};
+}
+
+static bstr make_text(void *ta_parent, int lines)
+{
+    char *text = talloc_strdup(ta_parent, "");
+    for (int n = 0; n < lines; n++)
+        text = talloc_asprintf_append(text, "line %d of some text file\n", n);
+    return bstr0(text);
+}
+
+static struct demuxer *open_sample(struct test_ctx *ctx, struct sample *s,
+                                   struct stream **out_stream)
+{
+    struct stream *stream = stream_memory_open(ctx->global, s->data.start,
+                                               s->data.len);
+    struct demuxer_params params = {
+        .external_stream = stream,
+    };
+    *out_stream = stream;
+    return demux_open_url("memory://", &params, NULL, ctx->global);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    void *tmp = talloc_new(NULL);
+
+    struct sample samples[] = {
+        {"noise", make_noise(tmp, 4 * 1024 * 1024)},
+        {"text", make_text(tmp, 10000)},
+        {"wav", make_wav(tmp, 48000), "wav"},
+    };
+
+    for (int n = 0; n < MP_ARRAY_SIZE(samples); n++) {
+        struct sample *s = &samples[n];
+        char found[80] = "not detected";
+        int64_t total = 0;
+        for (int i = 0; i < ROUNDS; i++) {
+            struct stream *stream;
+            int64_t t0 = mp_time_us();
+            struct demuxer *demux = open_sample(ctx, s, &stream);
+            total += mp_time_us() - t0;
+            if (demux) {
+                snprintf(found, sizeof(found), "%s", demux->filetype ?
+                         demux->filetype : demux->desc->name);
+            }
+            if (s->filetype) {
+                assert_true(demux);
+                assert_string_equal(found, s->filetype);
+            }
+            demux_free(demux);
+            free_stream(stream);
+        }
+        MP_INFO(ctx, "%-8s %8.3f ms per open (%s)\n", s->name,
+                total / (double)ROUNDS / 1e3, found);
+    }
+
+    talloc_free(tmp);
+}
+
+const struct unittest test_demux_probe = {
+    .name = "demux_probe",
+    .run = run,
+};
@@ -0,0 +1,156 @@
+#include "common/common.h"
+#include "common/msg.h"
+#include "input/cmd.h"
+#include "input/input.h"
+#include "input/keycodes.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+// input.c silently ignores sections beyond MAX_ACTIVE_SECTIONS (50), so stay
+// below that, leaving room for the "default" section.
+#define NUM_SECTIONS 40
+#define BINDS_PER_SECTION 50
+#define ROUNDS 20000
+
+static void wakeup(void *ctx)
+{
+}
+
+// Press the key, and return the command it was resolved to (freed on tmp).
+static char *press(void *tmp, struct input_ctx *ictx, int key)
+{
+    mp_input_put_key(ictx, key);
+    struct mp_cmd *cmd = mp_input_read_cmd(ictx);
+    if (!cmd)
+        return "";
+    char *res = talloc_strdup(tmp, cmd->original);
+    talloc_free(cmd);
+    return res;
+}
+
+static void check_resolve(struct test_ctx *ctx, struct input_ctx *ictx)
+{
+    void *tmp = talloc_new(NULL);
+
+    mp_input_define_section(ictx, "default", "builtin",
+                            "a show-text builtin-a\n"
+                            "b show-text builtin-b\n"
+                            "c show-text c\n", true, NULL);
+    mp_input_define_section(ictx, "default", "user",
+                            "a show-text user-a\n"
+                            "x-y-c show-text xyc\n"
+                            "y-c show-text yc\n", false, NULL);
+
+    // User binds are preferred over builtin binds.
+    assert_string_equal(press(tmp, ictx, 'a'), "show-text user-a");
+    assert_string_equal(press(tmp, ictx, 'b'), "show-text builtin-b");
+    // The longest matching key sequence wins.
+    assert_string_equal(press(tmp, ictx, 'c'), "show-text c");
+    press(tmp, ictx, 'y');
+    assert_string_equal(press(tmp, ictx, 'c'), "show-text yc");
+    press(tmp, ictx, 'x');
+    press(tmp, ictx, 'y');
+    assert_string_equal(press(tmp, ictx, 'c'), "show-text xyc");
+
+    // Sections on top of the stack take precedence.
+    mp_input_define_section(ictx, "s1", "s1", "a show-text s1-a\n", false, NULL);
+    mp_input_enable_section(ictx, "s1", 0);
+    assert_string_equal(press(tmp, ictx, 'a'), "show-text s1-a");
+    assert_string_equal(press(tmp, ictx, 'b'), "show-text builtin-b");
+    mp_input_enable_section(ictx, "s1", MP_INPUT_EXCLUSIVE);
+    assert_string_equal(press(tmp, ictx, 'b'), "");
+
+    // Redefining a section must not use stale binds.
+    mp_input_define_section(ictx, "s1", "s1", "b show-text s1-b\n", false, NULL);
+    mp_input_enable_section(ictx, "s1", 0);
+    assert_string_equal(press(tmp, ictx, 'a'), "show-text user-a");
+    assert_string_equal(press(tmp, ictx, 'b'), "show-text s1-b");
+    mp_input_disable_section(ictx, "s1");
+    assert_string_equal(press(tmp, ictx, 'b'), "show-text builtin-b");
+
+    talloc_free(tmp);
+}
+
+static void check_coalesce(struct test_ctx *ctx, struct input_ctx *ictx)
+{
+    mp_input_define_section(ictx, "wheel", "wheel",
+                            "WHEEL_UP add volume 1\n"
+                            "WHEEL_DOWN add volume -1\n", false, NULL);
+    mp_input_enable_section(ictx, "wheel", 0);
+
+    // Consecutive wheel events for the same binding are merged.
+    for (int n = 0; n < 3; n++)
+        mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    struct mp_cmd *cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd);
+    assert_string_equal(cmd->original, "add volume 1");
+    assert_float_equal(cmd->scale, 3.0, 1e-9);
+    talloc_free(cmd);
+    assert_true(!mp_input_read_cmd(ictx));
+
+    // Mouse moves are merged, and the last position is kept.
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    for (int n = 1; n <= 100; n++)
+        mp_input_set_mouse_pos_artificial(ictx, n, n * 2);
+    mp_input_put_wheel(ictx, MP_WHEEL_UP, 1.0);
+    cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd && !cmd->mouse_move);
+    talloc_free(cmd);
+    cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd && cmd->mouse_move);
+    assert_int_equal(cmd->mouse_x, 100);
+    assert_int_equal(cmd->mouse_y, 200);
+    talloc_free(cmd);
+    // Not merged with the wheel event before the mouse move.
+    cmd = mp_input_read_cmd(ictx);
+    assert_true(cmd && !cmd->mouse_move);
+    assert_float_equal(cmd->scale, 1.0, 1e-9);
+    talloc_free(cmd);
+    assert_true(!mp_input_read_cmd(ictx));
+
+    mp_input_disable_section(ictx, "wheel");
+}
+
+// Time resolving a key which is bound only in the bottom section, with many
+// sections (like defined by scripts) enabled above it.
+static void bench(struct test_ctx *ctx, struct input_ctx *ictx)
+{
+    void *tmp = talloc_new(NULL);
+
+    for (int n = 0; n < NUM_SECTIONS; n++) {
+        char *name = talloc_asprintf(tmp, "bench%d", n);
+        char *contents = talloc_strdup(tmp, "");
+        for (int i = 0; i < BINDS_PER_SECTION; i++) {
+            contents = talloc_asprintf_append(contents, "Ctrl+%c-%d ignore\n",
+                                              'a' + i % 26, i);
+        }
+        mp_input_define_section(ictx, name, "bench", contents, false, NULL);
+        mp_input_enable_section(ictx, name, 0);
+    }
+
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < ROUNDS; n++)
+        assert_string_equal(press(tmp, ictx, 'a'), "show-text user-a");
+    int64_t total = mp_time_us() - t0;
+
+    MP_INFO(ctx, "%d sections: %6.3f us per key\n", NUM_SECTIONS,
+            total / (double)ROUNDS);
+
+    talloc_free(tmp);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    struct input_ctx *ictx = mp_input_init(ctx->global, wakeup, NULL);
+
+    check_resolve(ctx, ictx);
+    check_coalesce(ctx, ictx);
+    bench(ctx, ictx);
+
+    mp_input_uninit(ictx);
+}
+
+const struct unittest test_input_bind = {
+    .name = "input_bind",
+    .run = run,
+};
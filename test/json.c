@@ -1,6 +1,8 @@
 #include "common/common.h"
+#include "common/msg.h"
 #include "misc/json.h"
 #include "misc/node.h"
+#include "osdep/timer.h"
 #include "tests.h"
 
 struct entry {
@@ -12,25 +14,8 @@ struct entry {
 
 #define TEXT(...) #__VA_ARGS__
 
-#define VAL_LIST(...) (struct mpv_node[]){__VA_ARGS__}
-
 #define L(...) __VA_ARGS__
 
-#define NODE_INT64(v) {.format = MPV_FORMAT_INT64,  .u = { .int64 = (v) }}
-#define NODE_STR(v)   {.format = MPV_FORMAT_STRING, .u = { .string = (v) }}
-#define NODE_BOOL(v)  {.format = MPV_FORMAT_FLAG,   .u = { .flag = (bool)(v) }}
-#define NODE_FLOAT(v) {.format = MPV_FORMAT_DOUBLE, .u = { .double_ = (v) }}
-#define NODE_NONE()   {.format = MPV_FORMAT_NONE }
-#define NODE_ARRAY(...) {.format = MPV_FORMAT_NODE_ARRAY, .u = { .list =    \
-    &(struct mpv_node_list) {                                               \
-        .num = sizeof(VAL_LIST(__VA_ARGS__)) / sizeof(struct mpv_node),     \
-        .values = VAL_LIST(__VA_ARGS__)}}}
-#define NODE_MAP(k, v) {.format = MPV_FORMAT_NODE_MAP, .u = { .list =       \
-    &(struct mpv_node_list) {                                               \
-        .num = sizeof(VAL_LIST(v)) / sizeof(struct mpv_node),               \
-        .values = VAL_LIST(v),                                              \
-        .keys = (char**)(const char *[]){k}}}}
-
 static const struct entry entries[] = {
     { "null", "null", NODE_NONE()},
     { "true", "true", NODE_BOOL(true)},
@@ -66,8 +51,88 @@ static const struct entry entries[] = {
 
 #define MAX_DEPTH 10
 
+// Typical IPC traffic: a command, and a property change event.
+static const char bench_cmd[] =
+    TEXT({"command": ["set_property", "sub-delay", 0.5], "request_id": 123});
+static const char bench_event[] =
+    TEXT({"event": "property-change", "id": 1, "name": "metadata",
+          "data": {"title": "Some \"title\"", "artist": "Someone",
+                   "track": 12, "tags": ["a", "b", "c"]}});
+
+#define BENCH_ITERATIONS 100000
+
+static void bench(struct test_ctx *ctx, const char *name, const char *src)
+{
+    void *tmp = talloc_new(NULL);
+    size_t len = strlen(src);
+    char *buf = talloc_size(tmp, len + 1);
+    struct json_arena *arena = json_arena_create(tmp);
+    struct mpv_node node;
+
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        void *ta = talloc_new(NULL);
+        memcpy(buf, src, len + 1);
+        char *s = buf;
+        assert_true(json_parse(ta, &node, &s, MAX_DEPTH) >= 0);
+        talloc_free(ta);
+    }
+
+    int64_t t1 = mp_time_us();
+    uint64_t allocs = 0;
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        if (n == 1)
+            allocs = json_arena_get_num_allocs(arena);
+        memcpy(buf, src, len + 1);
+        char *s = buf;
+        assert_true(json_parse_arena(arena, &node, &s, MAX_DEPTH) >= 0);
+        json_arena_reset(arena);
+    }
+    // Everything after the first message must reuse the arena's memory.
+    int arena_allocs = json_arena_get_num_allocs(arena) - allocs;
+    assert_int_equal(arena_allocs, 0);
+
+    memcpy(buf, src, len + 1);
+    char *s = buf;
+    assert_true(json_parse_arena(arena, &node, &s, MAX_DEPTH) >= 0);
+
+    int64_t t2 = mp_time_us();
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        char *d = talloc_strdup(NULL, "");
+        assert_true(json_write(&d, &node) >= 0);
+        talloc_free(d);
+    }
+
+    int64_t t3 = mp_time_us();
+    bstr out = {0};
+    size_t out_size = 0;
+    int out_allocs = -1; // the first message allocates the buffer
+    for (int n = 0; n < BENCH_ITERATIONS; n++) {
+        out.len = 0;
+        assert_true(json_write_bstr(&out, &node) >= 0);
+        out_allocs += talloc_get_size(out.start) != out_size;
+        out_size = talloc_get_size(out.start);
+    }
+    int64_t t4 = mp_time_us();
+    assert_int_equal(out_allocs, 0);
+
+    double mb = (double)len * BENCH_ITERATIONS / (1024 * 1024);
+    MP_INFO(ctx, "%s: parse %.1f MB/s, arena parse %.1f MB/s "
+            "(%.2f allocs/message), write %.1f MB/s, buffer write %.1f MB/s "
+            "(%.2f allocs/message)\n", name,
+            mb / ((t1 - t0) / 1e6), mb / ((t2 - t1) / 1e6),
+            arena_allocs / (double)BENCH_ITERATIONS,
+            mb / ((t3 - t2) / 1e6), mb / ((t4 - t3) / 1e6),
+            out_allocs / (double)BENCH_ITERATIONS);
+
+    talloc_free(out.start);
+    talloc_free(tmp);
+}
+
 static void run(struct test_ctx *ctx)
 {
+    struct json_arena *arena = json_arena_create(NULL);
+
     for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
         const struct entry *e = &entries[n];
         void *tmp = talloc_new(NULL);
@@ -84,8 +149,25 @@ static void run(struct test_ctx *ctx)
         assert_true(json_write(&d, &res) >= 0);
         assert_string_equal(e->out_txt, d);
         assert_true(equal_mpv_node(&e->out_data, &res));
+
+        // The arena parser must produce the same result.
+        s = talloc_strdup(tmp, e->src);
+        json_skip_whitespace(&s);
+        assert_true(json_parse_arena(arena, &res, &s, MAX_DEPTH) >= 0);
+        assert_true(equal_mpv_node(&e->out_data, &res));
+        bstr b = {0};
+        assert_true(json_write_bstr(&b, &res) >= 0);
+        assert_true(bstr_equals0(b, e->out_txt));
+        talloc_free(b.start);
+        json_arena_reset(arena);
+
         talloc_free(tmp);
     }
+
+    talloc_free(arena);
+
+    bench(ctx, "command", bench_cmd);
+    bench(ctx, "event", bench_event);
 }
 
 const struct unittest test_json = {
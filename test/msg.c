@@ -0,0 +1,109 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "common/msg_control.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+#define MSGS_PER_THREAD 20000
+#define MAX_THREADS 8
+
+struct receiver {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    bool need_wakeup;
+};
+
+static void wakeup_cb(void *p)
+{
+    struct receiver *r = p;
+    pthread_mutex_lock(&r->lock);
+    r->need_wakeup = true;
+    pthread_cond_signal(&r->wakeup);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void *sender_thread(void *p)
+{
+    struct mp_log *log = p;
+    for (int n = 0; n < MSGS_PER_THREAD; n++)
+        mp_msg(log, MSGL_DEBUG, "message %d from a benchmark thread\n", n);
+    return NULL;
+}
+
+static void bench(struct test_ctx *ctx, int num_threads)
+{
+    void *tmp = talloc_new(NULL);
+    struct receiver r = {0};
+    pthread_mutex_init(&r.lock, NULL);
+    pthread_cond_init(&r.wakeup, NULL);
+
+    struct mp_log_buffer *buffer =
+        mp_msg_log_buffer_new(ctx->global, 1000, MSGL_DEBUG, wakeup_cb, &r);
+
+    struct mp_log *logs[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    for (int n = 0; n < num_threads; n++)
+        logs[n] = mp_log_new(tmp, ctx->log, "msgbench");
+
+    int64_t total = num_threads * (int64_t)MSGS_PER_THREAD;
+    int64_t received = 0, dropped = 0;
+
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < num_threads; n++)
+        assert_true(pthread_create(&threads[n], NULL, sender_thread, logs[n]) == 0);
+    for (int n = 0; n < num_threads; n++)
+        pthread_join(threads[n], NULL);
+    int64_t t1 = mp_time_us();
+
+    // Every message must arrive, or be reported as dropped.
+    int64_t timeout = mp_add_timeout(t1, 10);
+    while (received + dropped < total) {
+        struct mp_log_buffer_entry *e = mp_msg_log_buffer_read(buffer);
+        if (!e) {
+            struct timespec ts = mp_time_us_to_timespec(timeout);
+            pthread_mutex_lock(&r.lock);
+            while (!r.need_wakeup) {
+                if (pthread_cond_timedwait(&r.wakeup, &r.lock, &ts))
+                    break;
+            }
+            r.need_wakeup = false;
+            pthread_mutex_unlock(&r.lock);
+            assert_true(mp_time_us() < timeout);
+            continue;
+        }
+        int64_t n;
+        if (strcmp(e->prefix, "overflow") == 0) {
+            assert_int_equal(sscanf(e->text, "log message buffer overflow: "
+                                    "%"SCNd64, &n), 1);
+            dropped += n;
+        } else if (strstr(e->prefix, "msgbench")) {
+            received += 1;
+        }
+        talloc_free(e);
+    }
+    assert_true(received <= total);
+
+    MP_INFO(ctx, "%d threads: %.0f messages/s, %"PRId64" received, "
+            "%"PRId64" dropped\n", num_threads,
+            total / ((t1 - t0) / 1e6), received, dropped);
+
+    mp_msg_log_buffer_destroy(buffer);
+    pthread_cond_destroy(&r.wakeup);
+    pthread_mutex_destroy(&r.lock);
+    talloc_free(tmp);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    for (int n = 1; n <= MAX_THREADS; n *= 2)
+        bench(ctx, n);
+}
+
+const struct unittest test_msg = {
+    .name = "msg",
+    .run = run,
+};
@@ -0,0 +1,160 @@
+#include "common/common.h"
+#include "misc/json.h"
+#include "misc/msgpack.h"
+#include "misc/node.h"
+#include "tests.h"
+
+#define MAX_DEPTH 10
+
+#define L(...) __VA_ARGS__
+
+#define NODE_BYTES(v) {.format = MPV_FORMAT_BYTE_ARRAY, .u = { .ba =        \
+    &(struct mpv_byte_array) {.data = (v), .size = sizeof(v) - 1}}}
+
+struct entry {
+    struct mpv_node node;
+    const char *msgpack; // expected encoding, or NULL to skip the check
+    size_t msgpack_len;
+    bool no_json;        // can't be represented in JSON
+};
+
+#define MSGPACK(s) .msgpack = (s), .msgpack_len = sizeof(s) - 1
+
+// Every node format, and the boundaries between the MessagePack encodings.
+static const struct entry entries[] = {
+    { NODE_NONE(),                      MSGPACK("\xc0") },
+    { NODE_BOOL(true),                  MSGPACK("\xc3") },
+    { NODE_BOOL(false),                 MSGPACK("\xc2") },
+    { NODE_INT64(0),                    MSGPACK("\x00") },
+    { NODE_INT64(127),                  MSGPACK("\x7f") },
+    { NODE_INT64(128),                  MSGPACK("\xcc\x80") },
+    { NODE_INT64(256),                  MSGPACK("\xcd\x01\x00") },
+    { NODE_INT64(-1),                   MSGPACK("\xff") },
+    { NODE_INT64(-32),                  MSGPACK("\xe0") },
+    { NODE_INT64(-33),                  MSGPACK("\xd0\xdf") },
+    { NODE_INT64(-129),                 MSGPACK("\xd1\xff\x7f") },
+    { NODE_INT64(70000),                MSGPACK("\xce\x00\x01\x11\x70") },
+    { NODE_INT64(-70000),               MSGPACK("\xd2\xff\xfe\xee\x90") },
+    { NODE_INT64(INT64_MAX) },
+    { NODE_INT64(INT64_MIN) },
+    { NODE_FLOAT(1.5),                  MSGPACK("\xcb\x3f\xf8\0\0\0\0\0\0") },
+    { NODE_FLOAT(-0.25) },
+    { NODE_STR(""),                     MSGPACK("\xa0") },
+    { NODE_STR("abc"),                  MSGPACK("\xa3" "abc") },
+    { NODE_STR("this string is 32 bytes long...."),
+      MSGPACK("\xd9\x20" "this string is 32 bytes long....") },
+    { NODE_STR("\xe2\x82\xac \"escaped\"\n") },
+    { NODE_BYTES("\0\1\2"),             MSGPACK("\xc4\x03\0\1\2"),
+      .no_json = true },
+    { NODE_ARRAY(NODE_INT64(1), NODE_STR("a")),
+                                        MSGPACK("\x92\x01\xa1" "a") },
+    { NODE_MAP(L("a"), L(NODE_INT64(1))),
+                                        MSGPACK("\x81\xa1" "a" "\x01") },
+    { NODE_MAP(L("command", "request_id"),
+               L(NODE_ARRAY(NODE_STR("set_property"), NODE_STR("pause"),
+                            NODE_BOOL(true)),
+                 NODE_INT64(5))) },
+    { NODE_ARRAY(NODE_ARRAY(), NODE_MAP(L("x"),
+                 L(NODE_ARRAY(NODE_NONE(), NODE_FLOAT(2.5))))) },
+};
+
+// Encodings the writer doesn't produce, but which must be accepted.
+#define IN(s, n) { (s), sizeof(s) - 1, n }
+static const struct {
+    const char *src;
+    size_t len;
+    struct mpv_node node;
+} inputs[] = {
+    IN("\xcc\xff",                              NODE_INT64(255)),
+    IN("\xcf\x00\x00\x00\x00\x00\x00\x00\x01",  NODE_INT64(1)),
+    IN("\xca\x3f\xc0\x00\x00",                  NODE_FLOAT(1.5)),
+    IN("\xda\x00\x01" "a",                      NODE_STR("a")),
+    IN("\xdc\x00\x01\xc0",                      NODE_ARRAY(NODE_NONE())),
+    IN("\xdf\x00\x00\x00\x01\xa1" "k" "\x01",
+                                              NODE_MAP(L("k"), L(NODE_INT64(1)))),
+};
+
+// Invalid input.
+static const char *const invalid[] = {
+    "\xc1",                                 // reserved
+    "\xd4\x01\x00",                         // extension type
+    "\xcf\xff\xff\xff\xff\xff\xff\xff\xff", // exceeds int64
+    "\x81\x01\x01",                         // non-string key
+    "\xdd\xff\xff\xff\xff",                 // bogus array size
+    "\x91\x91\x91\x91\x91\x91\x91\x91\x91\x91\x91\xc0", // too deep
+};
+
+static void round_trip_msgpack(const struct entry *e)
+{
+    bstr data = {0};
+    assert_true(msgpack_write(&data, &e->node) >= 0);
+    if (e->msgpack) {
+        assert_int_equal(data.len, e->msgpack_len);
+        assert_true(memcmp(data.start, e->msgpack, data.len) == 0);
+    }
+
+    void *tmp = talloc_new(NULL);
+    bstr src = data;
+    struct mpv_node res;
+    assert_true(msgpack_parse(tmp, &res, &src, MAX_DEPTH) >= 0);
+    assert_int_equal(src.len, 0);
+    assert_true(equal_mpv_node(&e->node, &res));
+
+    // Truncated input must be rejected.
+    for (size_t n = 0; n < data.len; n++) {
+        src = (bstr){data.start, n};
+        assert_true(msgpack_parse(tmp, &res, &src, MAX_DEPTH) < 0);
+    }
+
+    talloc_free(tmp);
+    talloc_free(data.start);
+}
+
+static void round_trip_json(const struct entry *e)
+{
+    bstr data = {0};
+    if (e->no_json) {
+        assert_true(json_write_bstr(&data, &e->node) < 0);
+        talloc_free(data.start);
+        return;
+    }
+    assert_true(json_write_bstr(&data, &e->node) >= 0);
+
+    void *tmp = talloc_new(NULL);
+    char *src = bstrto0(tmp, data);
+    struct mpv_node res;
+    assert_true(json_parse(tmp, &res, &src, MAX_DEPTH) >= 0);
+    assert_true(equal_mpv_node(&e->node, &res));
+    talloc_free(tmp);
+    talloc_free(data.start);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
+        round_trip_msgpack(&entries[n]);
+        round_trip_json(&entries[n]);
+    }
+
+    void *tmp = talloc_new(NULL);
+    struct mpv_node res;
+
+    for (int n = 0; n < MP_ARRAY_SIZE(inputs); n++) {
+        bstr src = {(char *)inputs[n].src, inputs[n].len};
+        assert_true(msgpack_parse(tmp, &res, &src, MAX_DEPTH) >= 0);
+        assert_int_equal(src.len, 0);
+        assert_true(equal_mpv_node(&inputs[n].node, &res));
+    }
+
+    for (int n = 0; n < MP_ARRAY_SIZE(invalid); n++) {
+        bstr src = bstr0(invalid[n]);
+        assert_true(msgpack_parse(tmp, &res, &src, MAX_DEPTH) < 0);
+    }
+
+    talloc_free(tmp);
+}
+
+const struct unittest test_msgpack = {
+    .name = "msgpack",
+    .run = run,
+};
@@ -0,0 +1,98 @@
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_option.h"
+#include "options/m_property.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+#define NUM_PROPS 1000
+#define BENCH_LOOKUPS 200000
+
+static int prop_index(void *ctx, struct m_property *prop, int action, void *arg)
+{
+    return m_property_int_ro(action, arg, (intptr_t)prop->priv);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    // Names with long common prefixes, which is what the real list looks
+    // like (e.g. all the "sub-" options).
+    struct m_property *list = talloc_zero_array(ta_ctx, struct m_property,
+                                                NUM_PROPS + 1);
+    char **names = talloc_array(ta_ctx, char *, NUM_PROPS);
+    for (int n = 0; n < NUM_PROPS; n++) {
+        names[n] = talloc_asprintf(ta_ctx, "prop-%d-%s", n % 37,
+                                   n % 2 ? "x" : "some-longer-name");
+        names[n] = talloc_asprintf_append(names[n], "-%d", n);
+        list[n] = (struct m_property){
+            .name = names[n],
+            .call = prop_index,
+            .priv = (void *)(intptr_t)n,
+        };
+    }
+
+    struct m_property_index *idx = m_property_index_new(ta_ctx, list);
+
+    for (int n = 0; n < NUM_PROPS; n++) {
+        const char *name = names[n];
+        assert_true(m_property_index_find(idx, name, strlen(name)) == &list[n]);
+
+        int val = -1;
+        assert_int_equal(m_property_do(ctx->log, idx, name, M_PROPERTY_GET,
+                                       &val, NULL), M_PROPERTY_OK);
+        assert_int_equal(val, n);
+
+        char *sub = talloc_asprintf(ta_ctx, "%s/sub", name);
+        assert_true(m_property_index_find(idx, sub, strlen(name)) == &list[n]);
+        assert_true(m_property_do(ctx->log, idx, sub, M_PROPERTY_GET, &val,
+                                  NULL) != M_PROPERTY_UNKNOWN);
+    }
+
+    // Prefixes and extensions of existing names must not match.
+    assert_true(!m_property_index_find(idx, names[0], strlen(names[0]) - 1));
+    char *ext = talloc_asprintf(ta_ctx, "%sx", names[0]);
+    assert_true(!m_property_index_find(idx, ext, strlen(ext)));
+    assert_true(!m_property_index_find(idx, "", 0));
+    int val;
+    assert_int_equal(m_property_do(ctx->log, idx, "unknown", M_PROPERTY_GET,
+                                   &val, NULL), M_PROPERTY_UNKNOWN);
+    assert_int_equal(m_property_do(ctx->log, idx, "unknown/sub",
+                                   M_PROPERTY_GET, &val, NULL),
+                     M_PROPERTY_UNKNOWN);
+
+    // Duplicates resolve to the first entry, like m_property_list_find().
+    struct m_property dup[] = {
+        {"a", prop_index, (void *)1},
+        {"b", prop_index, (void *)2},
+        {"a", prop_index, (void *)3},
+        {0}
+    };
+    struct m_property_index *dup_idx = m_property_index_new(ta_ctx, dup);
+    assert_true(m_property_index_find(dup_idx, "a", 1) == &dup[0]);
+    assert_true(m_property_list_find(dup, "a") == &dup[0]);
+
+    // Compare against the linear scan that was used before.
+    size_t found = 0;
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < BENCH_LOOKUPS; n++)
+        found += !!m_property_list_find(list, names[(n * 7919) % NUM_PROPS]);
+    int64_t t1 = mp_time_us();
+    for (int n = 0; n < BENCH_LOOKUPS; n++) {
+        const char *name = names[(n * 7919) % NUM_PROPS];
+        found += !!m_property_index_find(idx, name, strlen(name));
+    }
+    int64_t t2 = mp_time_us();
+    assert_int_equal(found, BENCH_LOOKUPS * 2);
+
+    MP_INFO(ctx, "%d lookups in %d properties: linear %.3f ms, index %.3f ms\n",
+            BENCH_LOOKUPS, NUM_PROPS, (t1 - t0) / 1e3, (t2 - t1) / 1e3);
+
+    talloc_free(ta_ctx);
+}
+
+const struct unittest test_property = {
+    .name = "property",
+    .run = run,
+};
@@ -5,15 +5,25 @@
 
 static const struct unittest *unittests[] = {
     &test_chmap,
+    &test_config_cache,
+    &test_demux_probe,
     &test_gl_video,
     &test_img_format,
+    &test_input_bind,
     &test_json,
     &test_linked_list,
+    &test_msg,
+    &test_msgpack,
     &test_paths,
+    &test_property,
     &test_repack_sws,
 #if HAVE_ZIMG
     &test_repack, // zimg only due to cross-checking with zimg.c
     &test_repack_zimg,
+#endif
+#if HAVE_POSIX
+    &test_vo_tct,
+    &test_wakeup,
 #endif
     NULL
 };
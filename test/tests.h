@@ -37,14 +37,22 @@ struct unittest {
 };
 
 extern const struct unittest test_chmap;
+extern const struct unittest test_config_cache;
+extern const struct unittest test_demux_probe;
 extern const struct unittest test_gl_video;
 extern const struct unittest test_img_format;
+extern const struct unittest test_input_bind;
 extern const struct unittest test_json;
 extern const struct unittest test_linked_list;
+extern const struct unittest test_msg;
+extern const struct unittest test_msgpack;
 extern const struct unittest test_repack_sws;
 extern const struct unittest test_repack_zimg;
 extern const struct unittest test_repack;
 extern const struct unittest test_paths;
+extern const struct unittest test_property;
+extern const struct unittest test_vo_tct;
+extern const struct unittest test_wakeup;
 
 #define assert_true(x) assert(x)
 #define assert_false(x) assert(!(x))
@@ -77,6 +85,24 @@ void assert_text_files_equal_impl(const char *file, int line,
 void assert_memcmp_impl(const char *file, int line,
                         const void *a, const void *b, size_t size);
 
+// Initializers for static struct mpv_node values (needs misc/node.h).
+#define VAL_LIST(...) (struct mpv_node[]){__VA_ARGS__}
+
+#define NODE_INT64(v) {.format = MPV_FORMAT_INT64,  .u = { .int64 = (v) }}
+#define NODE_STR(v)   {.format = MPV_FORMAT_STRING, .u = { .string = (v) }}
+#define NODE_BOOL(v)  {.format = MPV_FORMAT_FLAG,   .u = { .flag = (bool)(v) }}
+#define NODE_FLOAT(v) {.format = MPV_FORMAT_DOUBLE, .u = { .double_ = (v) }}
+#define NODE_NONE()   {.format = MPV_FORMAT_NONE }
+#define NODE_ARRAY(...) {.format = MPV_FORMAT_NODE_ARRAY, .u = { .list =    \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(__VA_ARGS__)) / sizeof(struct mpv_node),     \
+        .values = VAL_LIST(__VA_ARGS__)}}}
+#define NODE_MAP(k, v) {.format = MPV_FORMAT_NODE_MAP, .u = { .list =       \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(v)) / sizeof(struct mpv_node),               \
+        .values = VAL_LIST(v),                                              \
+        .keys = (char**)(const char *[]){k}}}}
+
 // Open a new file in the out_path. Always succeeds.
 FILE *test_open_out(struct test_ctx *ctx, const char *name);
 
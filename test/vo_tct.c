@@ -0,0 +1,85 @@
+#include <unistd.h>
+
+#include "options/m_config.h"
+#include "options/options.h"
+#include "osdep/io.h"
+#include "tests.h"
+#include "video/mp_image.h"
+#include "video/out/vo.h"
+
+// Must match vo_tct.c.
+#define FULL_REDRAW_INTERVAL 100
+
+extern const struct vo_driver video_out_tct;
+
+// Draw and flip img, and return the number of bytes written to stdout.
+static int64_t show_frame(struct vo *vo, struct mp_image *img)
+{
+    int64_t pos = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+    vo->driver->draw_image(vo, mp_image_new_ref(img));
+    vo->driver->flip_page(vo);
+    return lseek(STDOUT_FILENO, 0, SEEK_CUR) - pos;
+}
+
+static void run(struct test_ctx *ctx)
+{
+    struct vo *vo = talloc_zero(NULL, struct vo);
+    vo->driver = &video_out_tct;
+    vo->log = ctx->log;
+    vo->global = ctx->global;
+    vo->opts = mp_get_config_group(vo, ctx->global, &vo_sub_opts);
+    vo->priv = talloc_zero_size(vo, vo->driver->priv_size);
+
+    struct mp_image *img = mp_image_alloc(IMGFMT_BGR24, 64, 48);
+    assert_true(img);
+    for (int y = 0; y < img->h; y++) {
+        uint8_t *line = img->planes[0] + y * img->stride[0];
+        for (int x = 0; x < img->w * 3; x++)
+            line[x] = x * 4 + y;
+    }
+    struct mp_image_params params = img->params;
+    params.p_w = params.p_h = 1;
+    mp_image_params_guess_csp(&params);
+    vo->params = &params;
+
+    // The VO writes the frames to stdout; capture them in a file.
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    FILE *out = tmpfile();
+    assert_true(saved_stdout >= 0 && out);
+    dup2(fileno(out), STDOUT_FILENO);
+
+    assert_int_equal(vo->driver->preinit(vo), 0);
+    assert_int_equal(vo->driver->reconfig(vo, &params), 0);
+    fflush(stdout);
+
+    // The first frame is written completely, repeated frames not at all,
+    // until the periodic full redraw.
+    int64_t full = show_frame(vo, img);
+    assert_true(full > 0);
+    for (int n = 1; n < FULL_REDRAW_INTERVAL; n++)
+        assert_int_equal(show_frame(vo, img), 0);
+    assert_int_equal(show_frame(vo, img), full);
+    assert_int_equal(show_frame(vo, img), 0);
+
+    // A redraw request writes everything again. The image must be sent again,
+    // since the VO's copy can be stale.
+    assert_int_equal(vo->driver->control(vo, VOCTRL_REDRAW_FRAME, NULL),
+                     VO_NOTIMPL);
+    assert_int_equal(show_frame(vo, img), full);
+
+    vo->driver->uninit(vo);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    fclose(out);
+
+    talloc_free(img);
+    talloc_free(vo);
+}
+
+const struct unittest test_vo_tct = {
+    .name = "vo_tct",
+    .run = run,
+};
@@ -0,0 +1,183 @@
+#include <poll.h>
+#include <pthread.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/dispatch.h"
+#include "osdep/io.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+// Number of round trips per benchmark.
+#define ROUNDS 5000
+
+struct pingpong {
+    int ping[2], pong[2];
+    // condition variable case
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int ping_count, pong_count;
+    // dispatch case
+    struct mp_dispatch_queue *queue;
+    bool stop;
+};
+
+static bool is_readable(int fd)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+static void wait_fd(int fd)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    while (poll(&pfd, 1, -1) != 1) {}
+    mp_flush_wakeup_pipe(fd);
+}
+
+static void check_fd(int fds[2])
+{
+    assert_false(is_readable(fds[0]));
+    mp_signal_wakeup_fd(fds);
+    assert_true(is_readable(fds[0]));
+    mp_flush_wakeup_pipe(fds[0]);
+    assert_false(is_readable(fds[0]));
+    // Multiple wakeups must be collapsed by a single flush.
+    for (int n = 0; n < 3; n++)
+        mp_signal_wakeup_fd(fds);
+    assert_true(is_readable(fds[0]));
+    mp_flush_wakeup_pipe(fds[0]);
+    assert_false(is_readable(fds[0]));
+}
+
+static void *fd_thread(void *p)
+{
+    struct pingpong *pp = p;
+    for (int n = 0; n < ROUNDS; n++) {
+        wait_fd(pp->ping[0]);
+        mp_signal_wakeup_fd(pp->pong);
+    }
+    return NULL;
+}
+
+static void *cond_thread(void *p)
+{
+    struct pingpong *pp = p;
+    pthread_mutex_lock(&pp->lock);
+    for (int n = 0; n < ROUNDS; n++) {
+        while (pp->ping_count == pp->pong_count)
+            pthread_cond_wait(&pp->cond, &pp->lock);
+        pp->pong_count++;
+        pthread_cond_broadcast(&pp->cond);
+    }
+    pthread_mutex_unlock(&pp->lock);
+    return NULL;
+}
+
+static void *dispatch_thread(void *p)
+{
+    struct pingpong *pp = p;
+    while (!pp->stop)
+        mp_dispatch_queue_process(pp->queue, 1000);
+    return NULL;
+}
+
+static void dummy_fn(void *p)
+{
+}
+
+static void stop_fn(void *p)
+{
+    struct pingpong *pp = p;
+    pp->stop = true;
+}
+
+static void report(struct test_ctx *ctx, const char *name, int64_t t)
+{
+    MP_INFO(ctx, "%-14s %6.2f us per round trip\n", name, t / (double)ROUNDS);
+}
+
+static void bench_fd(struct test_ctx *ctx, const char *name, bool pipe_only)
+{
+    struct pingpong pp = {0};
+    if (pipe_only) {
+        assert_true(mp_make_wakeup_pipe(pp.ping) >= 0);
+        assert_true(mp_make_wakeup_pipe(pp.pong) >= 0);
+    } else {
+        assert_true(mp_make_wakeup_fd(pp.ping) >= 0);
+        assert_true(mp_make_wakeup_fd(pp.pong) >= 0);
+    }
+    check_fd(pp.ping);
+
+    pthread_t thread;
+    assert_true(pthread_create(&thread, NULL, fd_thread, &pp) == 0);
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < ROUNDS; n++) {
+        mp_signal_wakeup_fd(pp.ping);
+        wait_fd(pp.pong[0]);
+    }
+    int64_t t1 = mp_time_us();
+    pthread_join(thread, NULL);
+    report(ctx, name, t1 - t0);
+
+    mp_close_wakeup_fd(pp.ping);
+    mp_close_wakeup_fd(pp.pong);
+    assert_int_equal(pp.ping[0], -1);
+}
+
+static void bench_cond(struct test_ctx *ctx)
+{
+    struct pingpong pp = {0};
+    pthread_mutex_init(&pp.lock, NULL);
+    pthread_cond_init(&pp.cond, NULL);
+
+    pthread_t thread;
+    assert_true(pthread_create(&thread, NULL, cond_thread, &pp) == 0);
+    int64_t t0 = mp_time_us();
+    pthread_mutex_lock(&pp.lock);
+    for (int n = 0; n < ROUNDS; n++) {
+        pp.ping_count++;
+        pthread_cond_broadcast(&pp.cond);
+        while (pp.ping_count != pp.pong_count)
+            pthread_cond_wait(&pp.cond, &pp.lock);
+    }
+    pthread_mutex_unlock(&pp.lock);
+    int64_t t1 = mp_time_us();
+    pthread_join(thread, NULL);
+    report(ctx, "condvar", t1 - t0);
+
+    pthread_cond_destroy(&pp.cond);
+    pthread_mutex_destroy(&pp.lock);
+}
+
+static void bench_dispatch(struct test_ctx *ctx)
+{
+    struct pingpong pp = {
+        .queue = mp_dispatch_create(NULL),
+    };
+
+    pthread_t thread;
+    assert_true(pthread_create(&thread, NULL, dispatch_thread, &pp) == 0);
+    int64_t t0 = mp_time_us();
+    for (int n = 0; n < ROUNDS; n++)
+        mp_dispatch_run(pp.queue, dummy_fn, NULL);
+    int64_t t1 = mp_time_us();
+    mp_dispatch_run(pp.queue, stop_fn, &pp);
+    pthread_join(thread, NULL);
+    report(ctx, "dispatch", t1 - t0);
+
+    talloc_free(pp.queue);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    bench_fd(ctx, "pipe", true);
+    bench_fd(ctx, "wakeup fd", false);
+    bench_cond(ctx);
+    bench_dispatch(ctx);
+}
+
+const struct unittest test_wakeup = {
+    .name = "wakeup",
+    .run = run,
+};
@@ -0,0 +1,234 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#if HAVE_POSIX
+#include <sys/mman.h>
+#endif
+
+#include "common/common.h"
+#include "common/stats.h"
+#include "osdep/atomic.h"
+
+#include "image_arena.h"
+#include "mp_image.h"
+
+// Frames are backed by their own anonymous mappings, whose size and start
+// address are multiples of the huge page size. Since image pools recycle
+// frames, mapping costs are paid only once per pooled frame. Images smaller
+// than half a huge page don't benefit from huge pages and would waste most of
+// one, so they use the normal allocator. The huge page sizes depend on the
+// kernel configuration (e.g. 1 GiB hugetlb pages, or 512 MiB THP with 64 KiB
+// base pages on arm64), and are read from the kernel once.
+
+// Plane start and stride alignment. Page aligned mappings plus cache line
+// aligned planes and strides mean no plane row shares a cache line with
+// another.
+#define ARENA_ALIGN MP_IMAGE_BYTE_ALIGN
+
+static atomic_int arena_mode;
+
+// Statistics.
+static mp_atomic_int64 num_hugetlb;    // live frames backed by MAP_HUGETLB
+static mp_atomic_int64 num_thp;        // live frames backed by madvised THP
+static mp_atomic_int64 num_fallback;   // arena allocations that fell back
+                                       // (not counting too small images)
+static mp_atomic_int64 mapped_bytes;   // total size of live mappings
+
+void mp_image_arena_set_mode(enum mp_image_arena_mode mode)
+{
+    atomic_store(&arena_mode, mode);
+}
+
+enum mp_image_arena_mode mp_image_arena_get_mode(void)
+{
+    return atomic_load(&arena_mode);
+}
+
+#if HAVE_POSIX
+
+// The mapping kind is encoded in the lowest bit of the free callback opaque,
+// the mapping size (a multiple of the huge page size) in the rest.
+#define KIND_HUGETLB 1
+
+static pthread_once_t page_sizes_once = PTHREAD_ONCE_INIT;
+static size_t thp_page_size;        // 0 if unknown
+static size_t hugetlb_page_size;    // 0 if unknown
+
+static size_t read_size(const char *path, const char *prefix, size_t unit)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    uint64_t val = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, prefix, strlen(prefix)) == 0) {
+            if (sscanf(line + strlen(prefix), "%"SCNu64, &val) != 1)
+                val = 0;
+            break;
+        }
+    }
+    fclose(f);
+    val *= unit;
+    // Must be a power of 2, and fit the opaque encoding.
+    if (val < 2 || (val & (val - 1)) || val > INT_MAX)
+        return 0;
+    return val;
+}
+
+static void init_page_sizes(void)
+{
+    thp_page_size =
+        read_size("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "", 1);
+    hugetlb_page_size = read_size("/proc/meminfo", "Hugepagesize:", 1024);
+}
+
+static void free_mapping(void *opaque, uint8_t *data)
+{
+    uintptr_t v = (uintptr_t)opaque;
+    size_t size = v & ~(uintptr_t)KIND_HUGETLB;
+
+    munmap(data, size);
+
+    atomic_fetch_add(&mapped_bytes, -(int64_t)size);
+    atomic_fetch_add((v & KIND_HUGETLB) ? &num_hugetlb : &num_thp, -1);
+}
+
+// Map size bytes (a multiple of page_size) at a page_size aligned address,
+// and advise the kernel to use transparent huge pages.
+static void *map_thp(size_t size, size_t page_size)
+{
+    size_t map_size = size + page_size;
+    uint8_t *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    // Trim the unaligned head and the rest of the tail.
+    uint8_t *start = (uint8_t *)MP_ALIGN_UP((uintptr_t)p, page_size);
+    if (start > p)
+        munmap(p, start - p);
+    size_t tail = (p + map_size) - (start + size);
+    if (tail)
+        munmap(start + size, tail);
+
+#ifdef MADV_HUGEPAGE
+    madvise(start, size, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+static void *map_hugetlb(size_t size)
+{
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#else
+    return NULL;
+#endif
+}
+
+// Return the mapping size for an image of the given size, with a page size
+// of page_size, or 0 if the image should not use such pages.
+static size_t get_map_size(int size, size_t page_size)
+{
+    if (!page_size || size < 0 || (size_t)size < page_size / 2)
+        return 0;
+    size_t map_size = MP_ALIGN_UP((size_t)size, page_size);
+    return map_size <= INT_MAX ? map_size : 0;
+}
+
+struct mp_image *mp_image_arena_alloc(void *ctx, int fmt, int w, int h)
+{
+    int mode = mp_image_arena_get_mode();
+    if (mode == MP_IMAGE_ARENA_OFF)
+        return mp_image_alloc(fmt, w, h);
+
+    pthread_once(&page_sizes_once, init_page_sizes);
+
+    int size = mp_image_get_alloc_size(fmt, w, h, ARENA_ALIGN);
+    size_t hugetlb_size = 0;
+    if (mode == MP_IMAGE_ARENA_HUGETLB)
+        hugetlb_size = get_map_size(size, hugetlb_page_size);
+    size_t thp_size = get_map_size(size, thp_page_size);
+    if (!hugetlb_size && !thp_size)
+        return mp_image_alloc(fmt, w, h); // too small, or no huge pages
+
+    bool hugetlb = false;
+    size_t map_size = 0;
+    void *data = NULL;
+    if (hugetlb_size) {
+        map_size = hugetlb_size;
+        data = map_hugetlb(map_size);
+        hugetlb = !!data;
+    }
+    if (!data && thp_size) {
+        map_size = thp_size;
+        data = map_thp(map_size, thp_page_size);
+    }
+    if (!data)
+        goto fallback;
+
+    uintptr_t opaque = map_size | (hugetlb ? KIND_HUGETLB : 0);
+    struct mp_image *img =
+        mp_image_from_buffer(fmt, w, h, ARENA_ALIGN, data, map_size,
+                             (void *)opaque, free_mapping);
+    if (!img) {
+        munmap(data, map_size);
+        goto fallback;
+    }
+
+    atomic_fetch_add(&mapped_bytes, (int64_t)map_size);
+    atomic_fetch_add(hugetlb ? &num_hugetlb : &num_thp, 1);
+    return img;
+
+fallback:
+    atomic_fetch_add(&num_fallback, 1);
+    return mp_image_alloc(fmt, w, h);
+}
+
+#else /* HAVE_POSIX */
+
+struct mp_image *mp_image_arena_alloc(void *ctx, int fmt, int w, int h)
+{
+    return mp_image_alloc(fmt, w, h);
+}
+
+#endif /* else HAVE_POSIX */
+
+void mp_image_arena_report_stats(struct stats_ctx *ctx)
+{
+    if (mp_image_arena_get_mode() == MP_IMAGE_ARENA_OFF)
+        return;
+
+    stats_value(ctx, "image-arena-hugetlb-frames", atomic_load(&num_hugetlb));
+    stats_value(ctx, "image-arena-thp-frames", atomic_load(&num_thp));
+    stats_value(ctx, "image-arena-fallbacks", atomic_load(&num_fallback));
+    stats_size_value(ctx, "image-arena-mapped", atomic_load(&mapped_bytes));
+}
@@ -0,0 +1,22 @@
+#ifndef MPV_IMAGE_ARENA_H
+#define MPV_IMAGE_ARENA_H
+
+struct mp_image;
+struct stats_ctx;
+
+enum mp_image_arena_mode {
+    MP_IMAGE_ARENA_OFF = 0,     // plain av_buffer_alloc()
+    MP_IMAGE_ARENA_THP,         // transparent huge pages (madvise)
+    MP_IMAGE_ARENA_HUGETLB,     // MAP_HUGETLB, falling back to THP
+};
+
+// Process-wide; affects image pools created after the call.
+void mp_image_arena_set_mode(enum mp_image_arena_mode mode);
+enum mp_image_arena_mode mp_image_arena_get_mode(void);
+
+// Compatible with mp_image_allocator (ctx is ignored).
+struct mp_image *mp_image_arena_alloc(void *ctx, int fmt, int w, int h);
+
+void mp_image_arena_report_stats(struct stats_ctx *ctx);
+
+#endif
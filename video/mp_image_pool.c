@@ -29,8 +29,11 @@
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "common/stats.h"
+#include "misc/linked_list.h"
 
 #include "fmt-conversion.h"
+#include "image_arena.h"
 #include "mp_image.h"
 #include "mp_image_pool.h"
 
@@ -41,13 +44,30 @@ static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 // Thread-safety: the pool itself is not thread-safe, but pool-allocated images
 // can be referenced and unreferenced from other threads. (As long as the image
 // destructors are thread-safe.)
+// Since unused images can be trimmed from any thread (see global_pools.budget),
+// all pool fields describing the pool contents are protected by pool_mutex.
+
+// Number of hash table slots for the buckets of a pool (power of 2).
+#define BUCKET_SLOTS 16
+
+// Free images of a single format and size. Exists only while the pool has
+// images with these parameters.
+struct pool_bucket {
+    int fmt, w, h;
+    int num_images;             // images in the pool with these parameters
+    struct mp_image **free;     // unreferenced images (allocated num_images)
+    int num_free;
+    struct pool_bucket *next;   // next bucket in the same hash table slot
+};
 
 struct mp_image_pool {
+    // --- Protected by pool_mutex
     struct mp_image **images;
     int num_images;
 
-    int fmt, w, h;
+    struct pool_bucket *buckets[BUCKET_SLOTS];
 
+    // --- Owned by the pool user
     mp_image_allocator allocator;
     void *allocator_ctx;
 
@@ -55,6 +75,23 @@ struct mp_image_pool {
     unsigned int lru_counter;
 };
 
+struct image_flags;
+
+// Process-wide accounting over all pools. Protected by pool_mutex.
+static struct {
+    // Unused images of all pools, least recently released first.
+    struct {
+        struct image_flags *head, *tail;
+    } idle;
+
+    int64_t budget;             // max. bytes in unused images (0: unlimited)
+    int64_t resident_bytes;     // bytes in all images owned by pools
+    int64_t idle_bytes;         // bytes in unused images
+
+    // Counters reported by mp_image_pool_report_stats().
+    int64_t allocs, hits, misses, trims;
+} global_pools;
+
 // Used to gracefully handle the case when the pool is freed while image
 // references allocated from the image pool are still held by someone.
 struct image_flags {
@@ -62,6 +99,16 @@ struct image_flags {
     bool referenced;            // outside mp_image reference exists
     bool pool_alive;            // the mp_image_pool references this
     unsigned int order;         // for LRU allocation (basically a timestamp)
+    struct mp_image_pool *pool; // valid only if pool_alive
+    int64_t size;               // allocation size in bytes
+    // Valid only if pool_alive:
+    struct mp_image *img;
+    struct pool_bucket *bucket;
+    int index;                  // in pool->images[]
+    int free_index;             // in bucket->free[], if !referenced
+    struct {
+        struct image_flags *prev, *next;
+    } idle;                     // in global_pools.idle, if !referenced
 };
 
 static void image_pool_destructor(void *ptr)
@@ -76,24 +123,141 @@ struct mp_image_pool *mp_image_pool_new(void *tparent)
     struct mp_image_pool *pool = talloc_ptrtype(tparent, pool);
     talloc_set_destructor(pool, image_pool_destructor);
     *pool = (struct mp_image_pool) {0};
+    if (mp_image_arena_get_mode() != MP_IMAGE_ARENA_OFF)
+        pool->allocator = mp_image_arena_alloc;
     return pool;
 }
 
+static struct pool_bucket **bucket_slot(struct mp_image_pool *pool, int fmt,
+                                        int w, int h)
+{
+    uint32_t hash = ((uint32_t)fmt * 31 + (uint32_t)w) * 31 + (uint32_t)h;
+    hash = (hash * 2654435761u) >> 16;
+    return &pool->buckets[hash & (BUCKET_SLOTS - 1)];
+}
+
+static struct pool_bucket *find_bucket(struct mp_image_pool *pool, int fmt,
+                                       int w, int h)
+{
+    for (struct pool_bucket *b = *bucket_slot(pool, fmt, w, h); b; b = b->next) {
+        if (b->fmt == fmt && b->w == w && b->h == h)
+            return b;
+    }
+    return NULL;
+}
+
+// Add the unreferenced image to its bucket's free list and the global LRU.
+static void add_free_locked(struct image_flags *it)
+{
+    struct pool_bucket *b = it->bucket;
+    assert(b->num_free < b->num_images);
+    it->free_index = b->num_free;
+    b->free[b->num_free++] = it->img;
+    LL_APPEND(idle, &global_pools.idle, it);
+    global_pools.idle_bytes += it->size;
+}
+
+// Inverse of add_free_locked().
+static void remove_free_locked(struct image_flags *it)
+{
+    struct pool_bucket *b = it->bucket;
+    assert(b->free[it->free_index] == it->img);
+    struct mp_image *last = b->free[--b->num_free];
+    b->free[it->free_index] = last;
+    ((struct image_flags *)last->priv)->free_index = it->free_index;
+    LL_REMOVE(idle, &global_pools.idle, it);
+    global_pools.idle_bytes -= it->size;
+}
+
+// Remove the (unreferenced) image from the pool, and let the caller free it.
+static void remove_image_locked(struct mp_image_pool *pool,
+                                struct mp_image *img)
+{
+    struct image_flags *it = img->priv;
+    assert(it->pool_alive && !it->referenced);
+
+    remove_free_locked(it);
+
+    struct pool_bucket *b = it->bucket;
+    b->num_images -= 1;
+    if (!b->num_images) {
+        struct pool_bucket **p_prev = bucket_slot(pool, b->fmt, b->w, b->h);
+        while (*p_prev != b)
+            p_prev = &(*p_prev)->next;
+        *p_prev = b->next;
+        talloc_free(b);
+    }
+
+    struct mp_image *last = pool->images[--pool->num_images];
+    pool->images[it->index] = last;
+    ((struct image_flags *)last->priv)->index = it->index;
+
+    it->pool_alive = false;
+    global_pools.resident_bytes -= it->size;
+}
+
+// Free the least recently released unused images of all pools until the
+// budget is met. The images are returned in *out, to be freed by the caller
+// outside of the lock.
+static void trim_locked(struct mp_image ***out, int *num_out)
+{
+    while (global_pools.budget > 0 &&
+           global_pools.idle_bytes > global_pools.budget &&
+           global_pools.idle.head)
+    {
+        struct image_flags *it = global_pools.idle.head;
+        struct mp_image *img = it->img;
+        remove_image_locked(it->pool, img);
+        global_pools.trims += 1;
+        MP_TARRAY_APPEND(NULL, *out, *num_out, img);
+    }
+}
+
+static void free_images(struct mp_image **images, int num_images)
+{
+    for (int n = 0; n < num_images; n++)
+        talloc_free(images[n]);
+    talloc_free(images);
+}
+
 void mp_image_pool_clear(struct mp_image_pool *pool)
 {
+    struct mp_image **to_free = NULL;
+    int num_to_free = 0;
+
+    pool_lock();
     for (int n = 0; n < pool->num_images; n++) {
         struct mp_image *img = pool->images[n];
         struct image_flags *it = img->priv;
-        bool referenced;
-        pool_lock();
         assert(it->pool_alive);
+        if (!it->referenced) {
+            remove_free_locked(it);
+            MP_TARRAY_APPEND(NULL, to_free, num_to_free, img);
+        }
         it->pool_alive = false;
-        referenced = it->referenced;
-        pool_unlock();
-        if (!referenced)
-            talloc_free(img);
+        global_pools.resident_bytes -= it->size;
     }
     pool->num_images = 0;
+    for (int n = 0; n < BUCKET_SLOTS; n++) {
+        while (pool->buckets[n]) {
+            struct pool_bucket *b = pool->buckets[n];
+            pool->buckets[n] = b->next;
+            talloc_free(b);
+        }
+    }
+    pool_unlock();
+
+    free_images(to_free, num_to_free);
+}
+
+// Mark the image as unused. It's assumed it is alive.
+static void release_image_locked(struct mp_image *img)
+{
+    struct image_flags *it = img->priv;
+    assert(it->pool_alive && it->referenced);
+
+    it->referenced = false;
+    add_free_locked(it);
 }
 
 // This is the only function that is allowed to run in a different thread.
@@ -102,44 +266,29 @@ static void unref_image(void *opaque, uint8_t *data)
 {
     struct mp_image *img = opaque;
     struct image_flags *it = img->priv;
+    struct mp_image **to_free = NULL;
+    int num_to_free = 0;
     bool alive;
     pool_lock();
     assert(it->referenced);
-    it->referenced = false;
     alive = it->pool_alive;
+    if (alive) {
+        release_image_locked(img);
+        trim_locked(&to_free, &num_to_free);
+    } else {
+        it->referenced = false;
+    }
     pool_unlock();
     if (!alive)
         talloc_free(img);
+    free_images(to_free, num_to_free);
 }
 
-// Return a new image of given format/size. Unlike mp_image_pool_get(), this
-// returns NULL if there is no free image of this format/size.
-struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
-                                            int w, int h)
+// Create a reference to the pool image new, which was just marked as
+// referenced. Returns NULL on failure.
+static struct mp_image *pool_ref_image(struct mp_image_pool *pool,
+                                       struct mp_image *new)
 {
-    struct mp_image *new = NULL;
-    pool_lock();
-    for (int n = 0; n < pool->num_images; n++) {
-        struct mp_image *img = pool->images[n];
-        struct image_flags *img_it = img->priv;
-        assert(img_it->pool_alive);
-        if (!img_it->referenced) {
-            if (img->imgfmt == fmt && img->w == w && img->h == h) {
-                if (pool->use_lru) {
-                    struct image_flags *new_it = new ? new->priv : NULL;
-                    if (!new_it || new_it->order > img_it->order)
-                        new = img;
-                } else {
-                    new = img;
-                    break;
-                }
-            }
-        }
-    }
-    pool_unlock();
-    if (!new)
-        return NULL;
-
     // Reference the new image. Since mp_image_pool is not declared thread-safe,
     // and unreffing images from other threads does not allocate new images,
     // no synchronization is required here.
@@ -156,22 +305,93 @@ struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
                                     unref_image, new, flags);
     if (!ref->bufs[0]) {
         talloc_free(ref);
+        pool_lock();
+        release_image_locked(new);
+        pool_unlock();
         return NULL;
     }
 
     struct image_flags *it = new->priv;
-    assert(!it->referenced && it->pool_alive);
-    it->referenced = true;
     it->order = ++pool->lru_counter;
     return ref;
 }
 
-void mp_image_pool_add(struct mp_image_pool *pool, struct mp_image *new)
+// Return a new image of given format/size. Unlike mp_image_pool_get(), this
+// returns NULL if there is no free image of this format/size.
+struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
+                                            int w, int h)
+{
+    struct mp_image *new = NULL;
+    pool_lock();
+    struct pool_bucket *b = find_bucket(pool, fmt, w, h);
+    if (b && b->num_free) {
+        int index = b->num_free - 1; // most recently released (hot in cache)
+        if (pool->use_lru) {
+            for (int n = 0; n < b->num_free; n++) {
+                struct image_flags *it = b->free[n]->priv;
+                struct image_flags *best = b->free[index]->priv;
+                if (it->order < best->order)
+                    index = n;
+            }
+        }
+        new = b->free[index];
+
+        struct image_flags *it = new->priv;
+        assert(!it->referenced && it->pool_alive);
+        remove_free_locked(it);
+        it->referenced = true;
+        global_pools.hits += 1;
+    } else {
+        global_pools.misses += 1;
+    }
+    pool_unlock();
+    if (!new)
+        return NULL;
+
+    return pool_ref_image(pool, new);
+}
+
+static void pool_add(struct mp_image_pool *pool, struct mp_image *new,
+                     bool referenced)
 {
     struct image_flags *it = talloc_ptrtype(new, it);
-    *it = (struct image_flags) { .pool_alive = true };
+    *it = (struct image_flags) {
+        .pool_alive = true,
+        .referenced = referenced,
+        .pool = pool,
+        .size = new->bufs[0] ? new->bufs[0]->size : 0,
+        .img = new,
+    };
     new->priv = it;
+
+    pool_lock();
+    it->index = pool->num_images;
     MP_TARRAY_APPEND(pool, pool->images, pool->num_images, new);
+
+    struct pool_bucket *b = find_bucket(pool, new->imgfmt, new->w, new->h);
+    if (!b) {
+        struct pool_bucket **slot =
+            bucket_slot(pool, new->imgfmt, new->w, new->h);
+        b = talloc_ptrtype(pool, b);
+        *b = (struct pool_bucket){
+            .fmt = new->imgfmt, .w = new->w, .h = new->h,
+            .next = *slot,
+        };
+        *slot = b;
+    }
+    it->bucket = b;
+    b->num_images += 1;
+    // Make sure unref_image() never needs to allocate.
+    MP_TARRAY_GROW(b, b->free, b->num_images);
+    if (!referenced)
+        add_free_locked(it);
+    global_pools.resident_bytes += it->size;
+    pool_unlock();
+}
+
+void mp_image_pool_add(struct mp_image_pool *pool, struct mp_image *new)
+{
+    pool_add(pool, new, false);
 }
 
 // Return a new image of given format/size. The only difference to
@@ -187,11 +407,8 @@ struct mp_image *mp_image_pool_get(struct mp_image_pool *pool, int fmt,
         return mp_image_alloc(fmt, w, h);
     struct mp_image *new = mp_image_pool_get_no_alloc(pool, fmt, w, h);
     if (!new) {
-        if (fmt != pool->fmt || w != pool->w || h != pool->h)
-            mp_image_pool_clear(pool);
-        pool->fmt = fmt;
-        pool->w = w;
-        pool->h = h;
+        // Images of other sizes are kept, so switching back to them (e.g. with
+        // adaptive streams) reuses them. Unused images are freed by trimming.
         if (pool->allocator) {
             new = pool->allocator(pool->allocator_ctx, fmt, w, h);
         } else {
@@ -199,12 +416,52 @@ struct mp_image *mp_image_pool_get(struct mp_image_pool *pool, int fmt,
         }
         if (!new)
             return NULL;
-        mp_image_pool_add(pool, new);
-        new = mp_image_pool_get_no_alloc(pool, fmt, w, h);
+        // Add it as referenced, so it can't be trimmed before it's returned.
+        pool_add(pool, new, true);
+        pool_lock();
+        global_pools.allocs += 1;
+        pool_unlock();
+        new = pool_ref_image(pool, new);
     }
     return new;
 }
 
+// Set the maximum number of bytes all pools in the process may keep in unused
+// images. If it's exceeded, the least recently released images are freed. 0
+// means no limit.
+void mp_image_pool_set_max_idle_bytes(int64_t bytes)
+{
+    struct mp_image **to_free = NULL;
+    int num_to_free = 0;
+
+    pool_lock();
+    global_pools.budget = bytes;
+    trim_locked(&to_free, &num_to_free);
+    pool_unlock();
+
+    free_images(to_free, num_to_free);
+}
+
+// Report the process-wide pool statistics (see stats.h).
+void mp_image_pool_report_stats(struct stats_ctx *ctx)
+{
+    pool_lock();
+    int64_t resident = global_pools.resident_bytes;
+    int64_t idle = global_pools.idle_bytes;
+    int64_t allocs = global_pools.allocs;
+    int64_t hits = global_pools.hits;
+    int64_t misses = global_pools.misses;
+    int64_t trims = global_pools.trims;
+    pool_unlock();
+
+    stats_size_value(ctx, "image-pool-resident", resident);
+    stats_size_value(ctx, "image-pool-idle", idle);
+    stats_value(ctx, "image-pool-allocs", allocs);
+    stats_value(ctx, "image-pool-hits", hits);
+    stats_value(ctx, "image-pool-misses", misses);
+    stats_value(ctx, "image-pool-trims", trims);
+}
+
 // Like mp_image_new_copy(), but allocate the image out of the pool.
 // If pool==NULL, a plain copy is made (for convenience).
 // Returns NULL on OOM.
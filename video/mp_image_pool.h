@@ -2,8 +2,10 @@
 #define MPV_MP_IMAGE_POOL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct mp_image_pool;
+struct stats_ctx;
 
 struct mp_image_pool *mp_image_pool_new(void *tparent);
 struct mp_image *mp_image_pool_get(struct mp_image_pool *pool, int fmt,
@@ -14,6 +16,9 @@ void mp_image_pool_clear(struct mp_image_pool *pool);
 
 void mp_image_pool_set_lru(struct mp_image_pool *pool);
 
+void mp_image_pool_set_max_idle_bytes(int64_t bytes);
+void mp_image_pool_report_stats(struct stats_ctx *ctx);
+
 struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
                                             int w, int h);
 
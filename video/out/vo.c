@@ -826,16 +826,25 @@ bool vo_is_ready_for_frame(struct vo *vo, int64_t next_pts)
 void vo_queue_frame(struct vo *vo, struct vo_frame *frame)
 {
     struct vo_internal *in = vo->in;
+    int64_t queue_time = mp_time_us();
     pthread_mutex_lock(&in->lock);
     assert(vo->config_ok && !in->frame_queued &&
            (!in->current_frame || in->current_frame->num_vsyncs < 1));
     in->hasframe = true;
-    frame->frame_id = ++(in->current_frame_id);
+    uint64_t frame_id = frame->frame_id = ++(in->current_frame_id);
     in->frame_queued = frame;
     in->wakeup_pts = frame->display_synced
                    ? 0 : frame->pts + MPMAX(frame->duration, 0);
     wakeup_locked(vo);
     pthread_mutex_unlock(&in->lock);
+
+    // Links this to the video-draw span on the VO thread in traces. The flow
+    // must be sent within the span, so the span ends after it.
+    if (mp_msg_test(vo->log, MSGL_STATS)) {
+        MP_STATS(vo, "flow-start %"PRIu64" video-frame", frame_id);
+        MP_STATS(vo, "range-timed %"PRId64" %"PRId64" queue-frame",
+                 queue_time, mp_time_us());
+    }
 }
 
 // If a frame is currently being rendered (or queued), wait until it's done.
@@ -948,6 +957,8 @@ static bool render_frame(struct vo *vo)
             wakeup_core(vo);
 
         stats_time_start(in->stats, "video-draw");
+        if (!frame->repeat)
+            MP_STATS(vo, "flow-end %"PRIu64" video-frame", frame->frame_id);
 
         if (vo->driver->draw_frame) {
             vo->driver->draw_frame(vo, frame);
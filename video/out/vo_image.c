@@ -20,12 +20,15 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
+#include <libavutil/cpu.h>
 #include <libswscale/swscale.h>
 
 #include "config.h"
 #include "misc/bstr.h"
+#include "misc/thread_pool.h"
 #include "osdep/io.h"
 #include "options/m_config.h"
 #include "options/path.h"
@@ -50,6 +53,7 @@ static const struct m_sub_options image_writer_conf = {
 struct vo_image_opts {
     struct image_writer_opts *opts;
     char *outdir;
+    int threads;
 };
 
 #define OPT_BASE_STRUCT struct vo_image_opts
@@ -58,16 +62,37 @@ static const struct m_sub_options vo_image_conf = {
     .opts = (const struct m_option[]) {
         {"vo-image", OPT_SUBSTRUCT(opts, image_writer_conf)},
         {"vo-image-outdir", OPT_STRING(outdir), .flags = M_OPT_FILE},
+        {"vo-image-threads", OPT_CHOICE(threads, {"auto", 0}),
+            M_RANGE(1, 64)},
         {0},
     },
     .size = sizeof(struct vo_image_opts),
 };
 
+// Maximum number of frames handed to the encoder threads per thread. If this
+// many frames are still being written, flip_page() blocks, which in turn makes
+// vo_is_ready_for_frame() return false until a worker has finished a frame.
+#define QUEUE_PER_THREAD 2
+
 struct priv {
     struct vo_image_opts *opts;
 
     struct mp_image *current;
     int frame;
+
+    // Encoder workers; NULL if frames are written synchronously.
+    struct mp_thread_pool *pool;
+    int max_pending;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int pending;        // number of frames queued to or running on workers
+};
+
+struct write_job {
+    struct vo *vo;
+    struct mp_image *image;
+    char *filename;
 };
 
 static bool checked_mkdir(struct vo *vo, const char *buf)
@@ -104,6 +129,38 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
     osd_draw_on_image(vo->osd, dim, mpi->pts, OSD_DRAW_SUB_ONLY, p->current);
 }
 
+static void write_job_run(struct write_job *job)
+{
+    struct vo *vo = job->vo;
+    struct priv *p = vo->priv;
+
+    MP_INFO(vo, "Saving %s\n", job->filename);
+    write_image(job->image, p->opts->opts, job->filename, vo->global, vo->log);
+}
+
+static void write_job_worker(void *ctx)
+{
+    struct write_job *job = ctx;
+    struct priv *p = job->vo->priv;
+
+    write_job_run(job);
+    talloc_free(job);
+
+    pthread_mutex_lock(&p->lock);
+    p->pending -= 1;
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Block until at most max_pending frames are still being written.
+static void wait_pending(struct priv *p, int max_pending)
+{
+    pthread_mutex_lock(&p->lock);
+    while (p->pending > max_pending)
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
 static void flip_page(struct vo *vo)
 {
     struct priv *p = vo->priv;
@@ -112,18 +169,31 @@ static void flip_page(struct vo *vo)
 
     (p->frame)++;
 
-    void *t = talloc_new(NULL);
-    char *filename = talloc_asprintf(t, "%08d.%s", p->frame,
-                                     image_writer_file_ext(p->opts->opts));
+    struct write_job *job = talloc_zero(NULL, struct write_job);
+    job->vo = vo;
+    job->image = talloc_steal(job, p->current);
+    p->current = NULL;
+    job->filename = talloc_asprintf(job, "%08d.%s", p->frame,
+                                    image_writer_file_ext(p->opts->opts));
 
     if (p->opts->outdir && strlen(p->opts->outdir))
-        filename = mp_path_join(t, p->opts->outdir, filename);
+        job->filename = mp_path_join(job, p->opts->outdir, job->filename);
 
-    MP_INFO(vo, "Saving %s\n", filename);
-    write_image(p->current, p->opts->opts, filename, vo->global, vo->log);
+    if (!p->pool) {
+        write_job_run(job);
+        talloc_free(job);
+        return;
+    }
 
-    talloc_free(t);
-    mp_image_unrefp(&p->current);
+    // Each file is named after its frame number, so the workers can finish
+    // frames in any order.
+    wait_pending(p, p->max_pending - 1);
+    pthread_mutex_lock(&p->lock);
+    p->pending += 1;
+    pthread_mutex_unlock(&p->lock);
+
+    if (!mp_thread_pool_queue(p->pool, write_job_worker, job))
+        write_job_worker(job);
 }
 
 static int query_format(struct vo *vo, int fmt)
@@ -138,6 +208,15 @@ static void uninit(struct vo *vo)
     struct priv *p = vo->priv;
 
     mp_image_unrefp(&p->current);
+
+    if (p->pool) {
+        // Blocks until all queued frames have been written.
+        talloc_free(p->pool);
+        assert(p->pending == 0);
+    }
+
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
 }
 
 static int preinit(struct vo *vo)
@@ -146,6 +225,21 @@ static int preinit(struct vo *vo)
     p->opts = mp_get_config_group(vo, vo->global, &vo_image_conf);
     if (p->opts->outdir && !checked_mkdir(vo, p->opts->outdir))
         return -1;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
+
+    int threads = p->opts->threads;
+    if (threads == 0)
+        threads = MPMAX(av_cpu_count(), 1);
+    if (threads > 1) {
+        p->pool = mp_thread_pool_create(NULL, threads, threads, threads);
+        if (!p->pool)
+            MP_WARN(vo, "Could not create encoder threads.\n");
+        p->max_pending = threads * QUEUE_PER_THREAD;
+    }
+    MP_VERBOSE(vo, "Using %d encoder thread(s).\n", p->pool ? threads : 1);
+
     return 0;
 }
 
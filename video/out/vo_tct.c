@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <config.h>
@@ -42,13 +43,25 @@
 #define ESC_CLEAR_SCREEN "\033[2J"
 #define ESC_CLEAR_COLORS "\033[0m"
 #define ESC_GOTOXY "\033[%d;%df"
-#define ESC_COLOR_BG "\033[48;2;%d;%d;%dm"
-#define ESC_COLOR_FG "\033[38;2;%d;%d;%dm"
-#define ESC_COLOR256_BG "\033[48;5;%dm"
-#define ESC_COLOR256_FG "\033[38;5;%dm"
+#define ESC_COLOR_BG "\033[48;2;"
+#define ESC_COLOR_FG "\033[38;2;"
+#define ESC_COLOR256_BG "\033[48;5;"
+#define ESC_COLOR256_FG "\033[38;5;"
+#define LOWER_HALF_BLOCK "\xe2\x96\x84" // UTF8 bytes of U+2584
 #define DEFAULT_WIDTH 80
 #define DEFAULT_HEIGHT 25
 
+// Upper bound for the bytes written for a single cell: a cursor move, a
+// background and a foreground color sequence, and the character itself.
+#define MAX_CELL_BYTES (24 + 19 + 19 + 3)
+
+// Redraw all cells every this many frames, to repair the picture if something
+// else wrote to the terminal (log messages, the status line, scrolling).
+#define FULL_REDRAW_INTERVAL 100
+
+// Number of entries (log2) of the rgb_to_x256() result cache.
+#define X256_CACHE_BITS 12
+
 struct vo_tct_opts {
     int algo;
     int width;   // 0 -> default
@@ -73,16 +86,35 @@ static const struct m_sub_options vo_tct_conf = {
     .size = sizeof(struct vo_tct_opts),
 };
 
+// Colors of a terminal cell. Either packed 0xRRGGBB values, or xterm-256
+// color indexes in 256 color mode.
+struct cell {
+    uint32_t bg, fg;
+};
+
+struct x256_entry {
+    uint32_t key;   // 0xRRGGBB | X256_VALID
+    uint8_t color;
+};
+
+#define X256_VALID (1u << 24)
+
 struct priv {
     struct vo_tct_opts *opts;
-    size_t buffer_size;
-    char *buffer;
+    char *buffer;       // escape sequences for a whole frame
     int swidth;
     int sheight;
     struct mp_image *frame;
     struct mp_rect src;
     struct mp_rect dst;
     struct mp_sws_context *sws;
+
+    // Cells as they were last written to the terminal, for delta updates.
+    struct cell *cells;
+    bool full_redraw;
+    int frames_since_full_redraw;
+
+    struct x256_entry x256_cache[1 << X256_CACHE_BITS];
 };
 
 // Convert RGB24 to xterm-256 8-bit value
@@ -114,66 +146,147 @@ static int rgb_to_x256(uint8_t r, uint8_t g, uint8_t b)
     return color_err <= gray_err ? 16 + color_index() : 232 + gray_index;
 }
 
-static void write_plain(
-    const int dwidth, const int dheight,
-    const int swidth, const int sheight,
-    const unsigned char *source, const int source_stride,
-    bool term256)
+static uint8_t rgb_to_x256_cached(struct priv *p, uint32_t rgb)
+{
+    uint32_t hash = (rgb * 2654435761u) >> (32 - X256_CACHE_BITS);
+    struct x256_entry *e = &p->x256_cache[hash];
+    if (e->key != (rgb | X256_VALID)) {
+        e->key = rgb | X256_VALID;
+        e->color = rgb_to_x256(rgb >> 16, (rgb >> 8) & 0xFF, rgb & 0xFF);
+    }
+    return e->color;
+}
+
+#define EMIT(dst, s) (memcpy(dst, s, sizeof(s) - 1), (dst) + sizeof(s) - 1)
+
+static char *emit_uint(char *dst, unsigned int v)
+{
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n)
+        *dst++ = tmp[--n];
+    return dst;
+}
+
+static char *emit_gotoxy(char *dst, int row, int col)
+{
+    dst = EMIT(dst, "\033[");
+    dst = emit_uint(dst, row);
+    *dst++ = ';';
+    dst = emit_uint(dst, col);
+    *dst++ = 'f';
+    return dst;
+}
+
+static char *emit_color(char *dst, uint32_t c, bool fg, bool term256)
+{
+    if (term256) {
+        dst = fg ? EMIT(dst, ESC_COLOR256_FG) : EMIT(dst, ESC_COLOR256_BG);
+        dst = emit_uint(dst, c);
+    } else {
+        dst = fg ? EMIT(dst, ESC_COLOR_FG) : EMIT(dst, ESC_COLOR_BG);
+        dst = emit_uint(dst, c >> 16);
+        *dst++ = ';';
+        dst = emit_uint(dst, (c >> 8) & 0xFF);
+        *dst++ = ';';
+        dst = emit_uint(dst, c & 0xFF);
+    }
+    *dst++ = 'm';
+    return dst;
+}
+
+static inline uint32_t read_pixel(struct priv *p, const unsigned char *px)
 {
-    assert(source);
-    const int tx = (dwidth - swidth) / 2;
-    const int ty = (dheight - sheight) / 2;
-    for (int y = 0; y < sheight; y++) {
-        const unsigned char *row = source + y * source_stride;
-        printf(ESC_GOTOXY, ty + y, tx);
-        for (int x = 0; x < swidth; x++) {
-            unsigned char b = *row++;
-            unsigned char g = *row++;
-            unsigned char r = *row++;
-            if (term256) {
-                printf(ESC_COLOR256_BG, rgb_to_x256(r, g, b));
+    uint32_t rgb = (px[2] << 16) | (px[1] << 8) | px[0]; // BGR24
+    return p->opts->term256 ? rgb_to_x256_cached(p, rgb) : rgb;
+}
+
+// Render the scaled frame into p->buffer, skipping cells whose colors did not
+// change since the last frame. Returns the number of bytes written.
+static size_t render_frame(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    const bool half_blocks = p->opts->algo == ALGO_HALF_BLOCKS;
+    const bool term256 = p->opts->term256;
+    const unsigned char *source = p->frame->planes[0];
+    const int stride = p->frame->stride[0];
+    const int tx = (vo->dwidth - p->swidth) / 2;
+    const int ty = (vo->dheight - p->sheight) / 2;
+
+    char *dst = p->buffer;
+    bool colors_set = false;
+    struct cell cur = {0};
+
+    for (int y = 0; y < p->sheight; y++) {
+        const unsigned char *row_up = source + y * (half_blocks ? 2 : 1) * stride;
+        const unsigned char *row_down = row_up + stride;
+        struct cell *cells = p->cells + y * p->swidth;
+        bool need_goto = true;
+
+        for (int x = 0; x < p->swidth; x++) {
+            struct cell c = { .bg = read_pixel(p, row_up + x * 3) };
+            if (half_blocks)
+                c.fg = read_pixel(p, row_down + x * 3);
+
+            if (!p->full_redraw && c.bg == cells[x].bg && c.fg == cells[x].fg) {
+                need_goto = true;
+                continue;
+            }
+            cells[x] = c;
+
+            if (need_goto)
+                dst = emit_gotoxy(dst, ty + y + 1, tx + x + 1);
+            need_goto = false;
+
+            if (!colors_set || c.bg != cur.bg)
+                dst = emit_color(dst, c.bg, false, term256);
+            if (half_blocks && (!colors_set || c.fg != cur.fg))
+                dst = emit_color(dst, c.fg, true, term256);
+            cur = c;
+            colors_set = true;
+
+            if (half_blocks) {
+                dst = EMIT(dst, LOWER_HALF_BLOCK);
             } else {
-                printf(ESC_COLOR_BG, r, g, b);
+                *dst++ = ' ';
             }
-            printf(" ");
         }
-        printf(ESC_CLEAR_COLORS);
     }
-    printf("\n");
+
+    if (colors_set) {
+        dst = EMIT(dst, ESC_CLEAR_COLORS);
+        *dst++ = '\n';
+    }
+
+    if (p->full_redraw)
+        p->frames_since_full_redraw = 0;
+    p->full_redraw = false;
+    return dst - p->buffer;
 }
 
-static void write_half_blocks(
-    const int dwidth, const int dheight,
-    const int swidth, const int sheight,
-    unsigned char *source, int source_stride,
-    bool term256)
+static void write_frame(const char *buf, size_t len)
 {
-    assert(source);
-    const int tx = (dwidth - swidth) / 2;
-    const int ty = (dheight - sheight) / 2;
-    for (int y = 0; y < sheight * 2; y += 2) {
-        const unsigned char *row_up = source + y * source_stride;
-        const unsigned char *row_down = source + (y + 1) * source_stride;
-        printf(ESC_GOTOXY, ty + y / 2, tx);
-        for (int x = 0; x < swidth; x++) {
-            unsigned char b_up = *row_up++;
-            unsigned char g_up = *row_up++;
-            unsigned char r_up = *row_up++;
-            unsigned char b_down = *row_down++;
-            unsigned char g_down = *row_down++;
-            unsigned char r_down = *row_down++;
-            if (term256) {
-                printf(ESC_COLOR256_BG, rgb_to_x256(r_up, g_up, b_up));
-                printf(ESC_COLOR256_FG, rgb_to_x256(r_down, g_down, b_down));
-            } else {
-                printf(ESC_COLOR_BG, r_up, g_up, b_up);
-                printf(ESC_COLOR_FG, r_down, g_down, b_down);
-            }
-            printf("\xe2\x96\x84");  // UTF8 bytes of U+2584 (lower half block)
+    // Anything printed with stdio must come before the frame.
+    fflush(stdout);
+#if HAVE_POSIX
+    while (len) {
+        ssize_t r = write(STDOUT_FILENO, buf, len);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
         }
-        printf(ESC_CLEAR_COLORS);
+        buf += r;
+        len -= r;
     }
-    printf("\n");
+#else
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+#endif
 }
 
 static void get_win_size(struct vo *vo, int *out_width, int *out_height) {
@@ -200,8 +313,9 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     p->swidth = p->dst.x1 - p->dst.x0;
     p->sheight = p->dst.y1 - p->dst.y0;
 
-    if (p->buffer)
-        free(p->buffer);
+    TA_FREEP(&p->frame);
+    TA_FREEP(&p->buffer);
+    TA_FREEP(&p->cells);
 
     p->sws->src = *params;
     p->sws->dst = (struct mp_image_params) {
@@ -217,6 +331,11 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     if (!p->frame)
         return -1;
 
+    size_t num_cells = (size_t)p->swidth * p->sheight;
+    p->buffer = talloc_size(NULL, num_cells * MAX_CELL_BYTES + 64);
+    p->cells = talloc_zero_array(NULL, struct cell, num_cells);
+    p->full_redraw = true;
+
     if (mp_sws_reinit(p->sws) < 0)
         return -1;
 
@@ -238,18 +357,24 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
 static void flip_page(struct vo *vo)
 {
     struct priv *p = vo->priv;
-    if (p->opts->algo == ALGO_PLAIN) {
-        write_plain(
-            vo->dwidth, vo->dheight, p->swidth, p->sheight,
-            p->frame->planes[0], p->frame->stride[0],
-            p->opts->term256);
-    } else {
-        write_half_blocks(
-            vo->dwidth, vo->dheight, p->swidth, p->sheight,
-            p->frame->planes[0], p->frame->stride[0],
-            p->opts->term256);
+    if (!p->frame)
+        return;
+
+    int width, height;
+    get_win_size(vo, &width, &height);
+    if (width != vo->dwidth || height != vo->dheight) {
+        // Clears the screen and requests a redraw with the new size.
+        if (reconfig(vo, vo->params) < 0)
+            TA_FREEP(&p->frame);
+        return;
     }
-    fflush(stdout);
+
+    if (++p->frames_since_full_redraw >= FULL_REDRAW_INTERVAL)
+        p->full_redraw = true;
+
+    size_t len = render_frame(vo);
+    if (len)
+        write_frame(p->buffer, len);
 }
 
 static void uninit(struct vo *vo)
@@ -258,8 +383,9 @@ static void uninit(struct vo *vo)
     printf(ESC_CLEAR_SCREEN);
     printf(ESC_GOTOXY, 0, 0);
     struct priv *p = vo->priv;
-    if (p->buffer)
-        talloc_free(p->buffer);
+    talloc_free(p->frame);
+    talloc_free(p->buffer);
+    talloc_free(p->cells);
 }
 
 static int preinit(struct vo *vo)
@@ -283,6 +409,14 @@ static int query_format(struct vo *vo, int format)
 
 static int control(struct vo *vo, uint32_t request, void *data)
 {
+    struct priv *p = vo->priv;
+    switch (request) {
+    case VOCTRL_REDRAW_FRAME:
+        // Write all cells again. p->frame may not contain the image anymore
+        // (e.g. after a resize), so let the core send it again.
+        p->full_redraw = true;
+        return VO_NOTIMPL;
+    }
     return VO_NOTIMPL;
 }
 
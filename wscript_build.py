@@ -285,6 +285,7 @@ def build(ctx):
         ( "demux/demux_timeline.c" ),
         ( "demux/ebml.c" ),
         ( "demux/packet.c" ),
+        ( "demux/probe_cache.c" ),
         ( "demux/timeline.c" ),
 
         ( "filters/f_async_queue.c" ),
@@ -313,10 +314,12 @@ def build(ctx):
 
         ## Misc
         ( "misc/bstr.c" ),
+        ( "misc/cache_file.c" ),
         ( "misc/charset_conv.c" ),
         ( "misc/dispatch.c" ),
         ( "misc/jni.c",                          "android" ),
         ( "misc/json.c" ),
+        ( "misc/msgpack.c" ),
         ( "misc/natural_sort.c" ),
         ( "misc/node.c" ),
         ( "misc/rendezvous.c" ),
@@ -349,6 +352,7 @@ def build(ctx):
         ( "player/playloop.c" ),
         ( "player/screenshot.c" ),
         ( "player/scripting.c" ),
+        ( "player/shared_state.c" ),
         ( "player/sub.c" ),
         ( "player/video.c" ),
 
@@ -387,16 +391,24 @@ def build(ctx):
 
         ## Tests
         ( "test/chmap.c",                        "tests" ),
+        ( "test/config_cache.c",                 "tests" ),
+        ( "test/demux_probe.c",                  "tests" ),
         ( "test/gl_video.c",                     "tests" ),
         ( "test/img_format.c",                   "tests" ),
+        ( "test/input_bind.c",                   "tests" ),
         ( "test/json.c",                         "tests" ),
         ( "test/linked_list.c",                  "tests" ),
+        ( "test/msg.c",                          "tests" ),
+        ( "test/msgpack.c",                      "tests" ),
         ( "test/paths.c",                        "tests" ),
+        ( "test/property.c",                     "tests" ),
         ( "test/repack.c",                       "tests && zimg" ),
         ( "test/scale_sws.c",                    "tests" ),
         ( "test/scale_test.c",                   "tests" ),
         ( "test/scale_zimg.c",                   "tests && zimg" ),
         ( "test/tests.c",                        "tests" ),
+        ( "test/vo_tct.c",                       "tests && posix" ),
+        ( "test/wakeup.c",                       "tests && posix" ),
 
         ## Video
         ( "video/csputils.c" ),
@@ -415,6 +427,7 @@ def build(ctx):
         ( "video/fmt-conversion.c" ),
         ( "video/hwdec.c" ),
         ( "video/image_loader.c" ),
+        ( "video/image_arena.c" ),
         ( "video/image_writer.c" ),
         ( "video/img_format.c" ),
         ( "video/mp_image.c" ),